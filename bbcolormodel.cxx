@@ -24,15 +24,41 @@
 */
 
 
+#include <algorithm>
 #include <cmath>
 
+#include <iostream>
+
 #include "bbcolormodel.h"
 #include "constants.h"
 
 #include "errmsg.h"
 
+using std::cout;
+using std::max;
+using std::min;
+
 /*****************************************************************************/
 
+// Number of intervals in the temperature and limb darkening tables,
+// and the range of temperatures covered.  Colours outside the range
+// are calculated exactly, since with a low contrast they need not be
+// saturated there.
+static const int N_TEMP_TABLE = 4096;
+static const int N_MU_TABLE = 256;
+static const float T_TABLE_MIN = 100.0f;
+static const float T_TABLE_MAX = 1.0e7f;
+
+/*
+  Log of the black body flux (with the normalisation of get_flux) as a
+  function of x = hc / lambda k T.  Written so that it is accurate and
+  finite for all x > 0.
+*/
+static double log_flux(const double x)
+{
+  return -x - log(-expm1(-x));
+}
+
 /*
   Create a color model
 */
@@ -42,29 +68,75 @@ BB_color_model::BB_color_model(const float brightness1, const float contrast1)
   brightness = brightness1;
   contrast = contrast1;
 
-  // Define red, green and blue wavelengths; RGB is really NIR/opt/NUV
-  // to increase colour contrast
-  ref_red = 12500.0f;
-  ref_green = 5000.0f;
-  ref_blue = 2000.0f;
+  use_table = true;
+  init();
+}
 
-  // Define temperature of a 'white' object
-  ref_temp = 7000.0f;
+BB_color_model::BB_color_model(Key_list &params)
+{
+  // Set brightness and contrast
+  get_brightness_contrast(params, brightness, contrast);
 
-  // Define limb darkening coefficients
-  u_red = 0.8f;
-  u_green = 0.8f;
-  u_blue = 0.8f;
+  // Interpolate colours from tables?  Default true
+  try { use_table = params.get_bool("COLOUR_TABLE"); }
+  catch (Key_list::Key_not_found_exception) {
+    use_table = true;
+    print_default_key_msg("COLOUR_TABLE", "True");
+  }
 
-  // Calculate reference fluxes
-  f0_red = get_flux(ref_temp, ref_red);
-  f0_green = get_flux(ref_temp, ref_green);
-  f0_blue = get_flux(ref_temp, ref_blue);
+  // Report the accuracy of the tables?  Default false
+  bool test_table;
+  try { test_table = params.get_bool("COLOUR_TABLE_TEST"); }
+  catch (Key_list::Key_not_found_exception) {
+    test_table = false;
+  }
+
+  init();
+
+  if (test_table) 
+    cout << "   Maximum colour table error: " << get_table_error() << "\n";
 }
 
-BB_color_model::BB_color_model(Key_list &params)
+/*
+  Release dynamically allocated memory
+*/
+BB_color_model::~BB_color_model()
 {
-  // Set brightness and contrast
+  delete[] table_red;
+  delete[] table_green;
+  delete[] table_blue;
+  delete[] limb_red;
+  delete[] limb_green;
+  delete[] limb_blue;
+}
+
+/*
+  Change the brightness and contrast, tabulating colours again
+*/
+void BB_color_model::set_brightness_contrast(const float brightness1,
+					     const float contrast1)
+{
+  brightness = brightness1;
+  contrast = contrast1;
+
+  delete[] table_red;
+  delete[] table_green;
+  delete[] table_blue;
+  delete[] limb_red;
+  delete[] limb_green;
+  delete[] limb_blue;
+  init();
+}
+
+/*
+  Read brightness and contrast from a parameter list.  Nothing is
+  returned unless both are valid.
+*/
+void BB_color_model::get_brightness_contrast(Key_list &params, 
+					     float &brightness1, 
+					     float &contrast1)
+{
+  float brightness, contrast;
   try { brightness = params.get_float("BRIGHTNESS"); }
   catch (Key_list::Key_not_found_exception) {
     brightness = 0.6f;
@@ -79,6 +151,18 @@ BB_color_model::BB_color_model(Key_list &params)
   if (contrast <= 0.0f) 
     throw Key_list::Value_out_of_range_exception("CONTRAST", "> 0.0");
 
+  brightness1 = brightness;
+  contrast1 = contrast;
+}
+
+/*
+  Define the reference wavelengths, temperature and limb darkening and
+  tabulate colours for the current brightness and contrast
+*/
+void BB_color_model::init()
+{
+  using namespace Sci_const;
+
   // Define red, green and blue wavelengths; RGB is really NIR/opt/NUV
   // to increase colour contrast
   ref_red = 12500.0f;
@@ -97,6 +181,53 @@ BB_color_model::BB_color_model(Key_list &params)
   f0_red = get_flux(ref_temp, ref_red);
   f0_green = get_flux(ref_temp, ref_green);
   f0_blue = get_flux(ref_temp, ref_blue);
+
+  // Tabulate colours against log temperature.  The log of the flux is
+  // calculated directly so that it stays finite where the flux itself
+  // underflows.
+  t_min = T_TABLE_MIN;
+  t_max = T_TABLE_MAX;
+  log_t_min = log(T_TABLE_MIN);
+  t_scale = N_TEMP_TABLE / (log(T_TABLE_MAX) - log_t_min);
+
+  table_red = new float[N_TEMP_TABLE+2];
+  table_green = new float[N_TEMP_TABLE+2];
+  table_blue = new float[N_TEMP_TABLE+2];
+
+  const double x_red = 1.0e6 * H * C / K / (ref_red * 1e-4);
+  const double x_green = 1.0e6 * H * C / K / (ref_green * 1e-4);
+  const double x_blue = 1.0e6 * H * C / K / (ref_blue * 1e-4);
+  const double log_f0_red = log_flux(x_red / ref_temp);
+  const double log_f0_green = log_flux(x_green / ref_temp);
+  const double log_f0_blue = log_flux(x_blue / ref_temp);
+
+  for (int i = 0 ; i <= N_TEMP_TABLE ; i++) {
+    double temp = exp(log_t_min + i / t_scale);
+    table_red[i] = brightness + contrast * 
+      (log_flux(x_red / temp) - log_f0_red);
+    table_green[i] = brightness + contrast * 
+      (log_flux(x_green / temp) - log_f0_green);
+    table_blue[i] = brightness + contrast * 
+      (log_flux(x_blue / temp) - log_f0_blue);
+  }
+  table_red[N_TEMP_TABLE+1] = table_red[N_TEMP_TABLE];
+  table_green[N_TEMP_TABLE+1] = table_green[N_TEMP_TABLE];
+  table_blue[N_TEMP_TABLE+1] = table_blue[N_TEMP_TABLE];
+
+  // Tabulate limb darkening against mu
+  limb_red = new float[N_MU_TABLE+2];
+  limb_green = new float[N_MU_TABLE+2];
+  limb_blue = new float[N_MU_TABLE+2];
+
+  for (int i = 0 ; i <= N_MU_TABLE ; i++) {
+    double mu = static_cast<double> (i) / N_MU_TABLE;
+    limb_red[i] = contrast * log(1.0 - (1.0 - mu) * u_red);
+    limb_green[i] = contrast * log(1.0 - (1.0 - mu) * u_green);
+    limb_blue[i] = contrast * log(1.0 - (1.0 - mu) * u_blue);
+  }
+  limb_red[N_MU_TABLE+1] = limb_red[N_MU_TABLE];
+  limb_green[N_MU_TABLE+1] = limb_green[N_MU_TABLE];
+  limb_blue[N_MU_TABLE+1] = limb_blue[N_MU_TABLE];
 }
 
 /*
@@ -104,31 +235,82 @@ BB_color_model::BB_color_model(Key_list &params)
 */
 Vec3 BB_color_model::get_rgb(const float temp)
 {
-  // Calculate fluxes
-  const float f_red = get_flux(temp, ref_red);
-  const float f_green = get_flux(temp, ref_green);
-  const float f_blue = get_flux(temp, ref_blue);
+  return get_rgb(temp, 1.0f);
+}
 
-  // Divide by reference flux and calculate colour components
-  float red = brightness + log(f_red / f0_red) * contrast;
-  if (red < 0.0f) red = 0.0f;
-  else if (red > 1.0f) red = 1.0f;
+/*
+  Get RGB values between 0 and 1 allowing for limb darkening
+*/
+Vec3 BB_color_model::get_rgb(const float temp, const float mu)
+{
+  if (!use_table) return get_exact_rgb(temp, mu);
 
-  float green = brightness + log(f_green / f0_green) * contrast;
-  if (green < 0.0f) green = 0.0f;
-  else if (green > 1.0f) green = 1.0f;
+  Vec3 rgb;
+  get_rgb(1, &temp, &mu, &rgb.x, &rgb.y, &rgb.z);
+  return rgb;
+}
 
-  float blue = brightness + log(f_blue / f0_blue) * contrast;
-  if (blue < 0.0f) blue = 0.0f;
-  else if (blue > 1.0f) blue = 1.0f;
+/*
+  Get RGB values for n points at once.  Apart from clamping, the main
+  loop has no branches and reads the tables without bounds checks, so
+  that the compiler can vectorise it.  Points with temperatures outside
+  the tables are then calculated exactly.
+*/
+void BB_color_model::get_rgb(const int n, const float *temp, 
+			     const float *mu, float *red, float *green, 
+			     float *blue)
+{
+  if (!use_table) {
+    for (int i = 0 ; i < n ; i++) {
+      Vec3 rgb = get_exact_rgb(temp[i], mu[i]);
+      red[i] = rgb.x;
+      green[i] = rgb.y;
+      blue[i] = rgb.z;
+    }
+    return;
+  }
 
-  return Vec3(red, green, blue);
+  for (int i = 0 ; i < n ; i++) {
+    // Position in temperature table
+    float x = (log(max(temp[i], t_min)) - log_t_min) * t_scale;
+    x = min(x, static_cast<float> (N_TEMP_TABLE));
+    int i_t = static_cast<int> (x);
+    float f_t = x - i_t;
+
+    // Position in limb darkening table
+    float y = min(max(mu[i], 0.0f), 1.0f) * N_MU_TABLE;
+    int i_mu = static_cast<int> (y);
+    float f_mu = y - i_mu;
+
+    // Interpolate colour components
+    float r = table_red[i_t] + f_t * (table_red[i_t+1] - table_red[i_t]) +
+      limb_red[i_mu] + f_mu * (limb_red[i_mu+1] - limb_red[i_mu]);
+    float g = table_green[i_t] + 
+      f_t * (table_green[i_t+1] - table_green[i_t]) +
+      limb_green[i_mu] + f_mu * (limb_green[i_mu+1] - limb_green[i_mu]);
+    float b = table_blue[i_t] + f_t * (table_blue[i_t+1] - table_blue[i_t]) +
+      limb_blue[i_mu] + f_mu * (limb_blue[i_mu+1] - limb_blue[i_mu]);
+
+    red[i] = min(max(r, 0.0f), 1.0f);
+    green[i] = min(max(g, 0.0f), 1.0f);
+    blue[i] = min(max(b, 0.0f), 1.0f);
+  }
+
+  for (int i = 0 ; i < n ; i++) {
+    if (temp[i] >= t_min && temp[i] <= t_max) continue;
+
+    Vec3 rgb = get_exact_rgb(temp[i], mu[i]);
+    red[i] = rgb.x;
+    green[i] = rgb.y;
+    blue[i] = rgb.z;
+  }
 }
 
 /*
-  Get RGB values between 0 and 1 allowing for limb darkening
+  Get RGB values between 0 and 1 allowing for limb darkening,
+  calculated exactly
 */
-Vec3 BB_color_model::get_rgb(const float temp, const float mu)
+Vec3 BB_color_model::get_exact_rgb(const float temp, const float mu)
 {
   // Calculate fluxes
   float f_red = get_flux(temp, ref_red);
@@ -156,6 +338,35 @@ Vec3 BB_color_model::get_rgb(const float temp, const float mu)
   return Vec3(red, green, blue);
 }
 
+/*
+  Compare tabulated and exact colours over a fine grid of temperatures
+  (extending beyond the table) and viewing angles, and return the
+  largest difference in any colour component
+*/
+float BB_color_model::get_table_error()
+{
+  const int n_temp = 100000, n_mu = 40;
+  const float log_t1 = log(10.0f), log_t2 = log(1.0e9f);
+
+  float max_err = 0.0f;
+  for (int i = 0 ; i <= n_temp ; i++) {
+    float temp = exp(log_t1 + (log_t2 - log_t1) * i / n_temp);
+    for (int j = 0 ; j <= n_mu ; j++) {
+      float mu = static_cast<float> (j) / n_mu;
+
+      Vec3 rgb;
+      get_rgb(1, &temp, &mu, &rgb.x, &rgb.y, &rgb.z);
+      Vec3 exact = get_exact_rgb(temp, mu);
+
+      max_err = max(max_err, static_cast<float> (fabs(rgb.x - exact.x)));
+      max_err = max(max_err, static_cast<float> (fabs(rgb.y - exact.y)));
+      max_err = max(max_err, static_cast<float> (fabs(rgb.z - exact.z)));
+    }
+  }
+
+  return max_err;
+}
+
 /*
   Calculate the black body flux
 */
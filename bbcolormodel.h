@@ -48,14 +48,58 @@ class BB_color_model {
 
   // Brightness and contrast factors
   float brightness, contrast;
+
+  // Colours are interpolated from tables if set, rather than
+  // calculated exactly
+  bool use_table;
+
+  // Colour components before limb darkening, tabulated against log
+  // temperature.  Each table has one spare entry at the end so that
+  // interpolation never needs a bounds check.
+  float *table_red, *table_green, *table_blue;
+  float log_t_min, t_min, t_max, t_scale;
+
+  // Change in colour components due to limb darkening, tabulated
+  // against mu
+  float *limb_red, *limb_green, *limb_blue;
+
+  // Set up the reference values and tables
+  void init();
+
+  // Not copyable
+  BB_color_model(const BB_color_model&);
+  BB_color_model& operator= (const BB_color_model&);
+
+  // The GPU version of this model uses the same constants
+  friend class BB_shader;
 public:
   // Constructors
   BB_color_model(const float brightness1, const float contrast1);
   BB_color_model(Key_list &params);
 
+  ~BB_color_model();
+
+  // Read and check the brightness and contrast in a parameter list
+  static void get_brightness_contrast(Key_list &params, float &brightness1,
+				      float &contrast1);
+
+  // Change the brightness and contrast
+  void set_brightness_contrast(const float brightness1, 
+			       const float contrast1);
+
   // Get RGB values between 0 and 1
   Vec3 get_rgb(const float temp);
   Vec3 get_rgb(const float temp, const float mu);
+
+  // Get RGB values for n points at once allowing for limb darkening
+  void get_rgb(const int n, const float *temp, const float *mu,
+	       float *red, float *green, float *blue);
+
+  // Get RGB values exactly, without using the tables
+  Vec3 get_exact_rgb(const float temp, const float mu);
+
+  // Return the largest difference between tabulated and exact colours
+  float get_table_error();
   
   // Calculate a black body flux
   float get_flux(const float temp, float wavelength);
@@ -0,0 +1,264 @@
+/*
+  GLSL program to calculate black body colours on the GPU
+  
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+// OpenGL 2.0 entry points are declared by glext.h on most platforms
+#ifndef NOGLEXT
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <cmath>
+
+#include <iostream>
+
+#include "bbshader.h"
+#include "constants.h"
+
+using std::cout;
+
+/*****************************************************************************/
+
+#ifndef NOGLEXT
+
+/*
+  Vertex shader.  Applies granulation to the temperature and passes it
+  on with the surface normal.  The per-vertex inputs are the normal and
+  two texture coordinates: (temperature, irradiation temperature,
+  granulation phases) and the fraction between the two granules.
+*/
+static const char *vertex_source =
+  "#version 110\n"
+  "uniform float phase, gran_amp, gran_period;\n"
+  "varying vec3 normal;\n"
+  "varying float temp;\n"
+  "void main() {\n"
+  "  const float TWO_PI = 6.2831853;\n"
+  "  vec4 t = gl_MultiTexCoord0;\n"
+  "  float frac = gl_MultiTexCoord1.x;\n"
+  "  float gran1 = 1.0 + gran_amp * sin(TWO_PI * phase * 10.0 + t.z);\n"
+  "  float gran2 = 1.0 + gran_amp * sin(TWO_PI * phase / gran_period + t.w);\n"
+  "  float t1 = t.x * ((1.0 - frac) * gran1 + frac * gran2);\n"
+  "  t1 *= t1;\n"
+  "  float t2 = t.y * t.y;\n"
+  "  temp = sqrt(sqrt(t1*t1 + t2*t2));\n"
+  "  normal = gl_Normal;\n"
+  "  gl_Position = ftransform();\n"
+  "}\n";
+
+/*
+  Fragment shader.  Calculates the log of the black body flux in each
+  band relative to the reference temperature, applies linear limb
+  darkening and maps the result to RGB with the brightness and
+  contrast of the colour model.  The flux is worked with in log form,
+  log(1 / (exp(x) - 1)) = -x - log(1 - exp(-x)), which does not
+  overflow for cool surfaces.
+*/
+static const char *fragment_source =
+  "#version 110\n"
+  "uniform vec3 eye, x_ref, log_f0, limb;\n"
+  "uniform float brightness, contrast;\n"
+  "varying vec3 normal;\n"
+  "varying float temp;\n"
+  "void main() {\n"
+  "  float mu = abs(dot(normalize(normal), eye));\n"
+  "  vec3 x = x_ref / max(temp, 1.0);\n"
+  "  vec3 log_f = -x - log(1.0 - exp(-x));\n"
+  "  log_f += log(1.0 - (1.0 - mu) * limb);\n"
+  "  vec3 rgb = brightness + (log_f - log_f0) * contrast;\n"
+  "  gl_FragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);\n"
+  "}\n";
+
+/*
+  Compile and link the program and set the constant uniforms from the
+  colour model
+*/
+BB_shader::BB_shader(const BB_color_model &cm)
+{
+  ready = false;
+  program = 0;
+
+  GLuint vertex_shader = compile(GL_VERTEX_SHADER, vertex_source);
+  GLuint fragment_shader = compile(GL_FRAGMENT_SHADER, fragment_source);
+  if (vertex_shader == 0 || fragment_shader == 0) return;
+
+  program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  glLinkProgram(program);
+
+  // The shaders are freed along with the program
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  GLint status;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (!status) {
+    char log[1024];
+    glGetProgramInfoLog(program, sizeof(log), 0, log);
+    cout << "   Failed to link shaders:\n" << log << "\n";
+    return;
+  }
+
+  eye_loc = glGetUniformLocation(program, "eye");
+  phase_loc = glGetUniformLocation(program, "phase");
+  gran_amp_loc = glGetUniformLocation(program, "gran_amp");
+  gran_period_loc = glGetUniformLocation(program, "gran_period");
+
+  set_colour_model(cm);
+
+  ready = true;
+}
+
+/*
+  Set the uniforms taken from the colour model
+*/
+void BB_shader::set_colour_model(const BB_color_model &cm)
+{
+  using namespace Sci_const;
+
+  // Exponents of the black body at unit temperature, matching
+  // BB_color_model::get_flux, and the log fluxes at the reference
+  // temperature
+  const double hck = 1.0e6 * H * C / K;
+  double x_red = hck / (cm.ref_red * 1e-4);
+  double x_green = hck / (cm.ref_green * 1e-4);
+  double x_blue = hck / (cm.ref_blue * 1e-4);
+
+  glUseProgram(program);
+  glUniform3f(glGetUniformLocation(program, "x_ref"), 
+	      x_red, x_green, x_blue);
+  glUniform3f(glGetUniformLocation(program, "log_f0"), 
+	      log(cm.f0_red), log(cm.f0_green), log(cm.f0_blue));
+  glUniform3f(glGetUniformLocation(program, "limb"), 
+	      cm.u_red, cm.u_green, cm.u_blue);
+  glUniform1f(glGetUniformLocation(program, "brightness"), cm.brightness);
+  glUniform1f(glGetUniformLocation(program, "contrast"), cm.contrast);
+  glUseProgram(0);
+}
+
+/*
+  Release the program
+*/
+BB_shader::~BB_shader()
+{
+  if (program) glDeleteProgram(program);
+}
+
+/*
+  Compile one shader stage.  Errors are reported and 0 returned.
+*/
+GLuint BB_shader::compile(const GLenum type, const char *source)
+{
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, 0);
+  glCompileShader(shader);
+
+  GLint status;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (!status) {
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), 0, log);
+    cout << "   Failed to compile shader:\n" << log << "\n";
+    glDeleteShader(shader);
+    return 0;
+  }
+
+  return shader;
+}
+
+/*
+  Start and stop using the program
+*/
+void BB_shader::enable()
+{
+  glUseProgram(program);
+}
+
+void BB_shader::disable()
+{
+  glUseProgram(0);
+}
+
+/*
+  Set the direction to the observer
+*/
+void BB_shader::set_eye(const Vec3 &eye)
+{
+  glUniform3f(eye_loc, eye.x, eye.y, eye.z);
+}
+
+/*
+  Set granulation for the current phase
+*/
+void BB_shader::set_granulation(const float phase, const float amplitude,
+				const float period)
+{
+  glUniform1f(phase_loc, phase);
+  glUniform1f(gran_amp_loc, amplitude);
+  glUniform1f(gran_period_loc, period);
+}
+
+/*
+  Supply normal, temperatures and granulation for the next vertex
+*/
+void BB_shader::set_vertex(const Vec3 &normal, const float temp, 
+			   const float t_irr, const float gran_phase1, 
+			   const float gran_phase2, const float gran_frac)
+{
+  glNormal3f(normal.x, normal.y, normal.z);
+  glMultiTexCoord4f(GL_TEXTURE0, temp, t_irr, gran_phase1, gran_phase2);
+  glMultiTexCoord1f(GL_TEXTURE1, gran_frac);
+}
+
+#else
+
+/*
+  Shaders are not available without OpenGL 2.0 headers
+*/
+BB_shader::BB_shader(const BB_color_model &cm)
+{
+  ready = false;
+  program = 0;
+  cout << "   Compiled without shader support\n";
+}
+
+BB_shader::~BB_shader() { }
+
+void BB_shader::set_colour_model(const BB_color_model &cm) { }
+
+GLuint BB_shader::compile(const GLenum type, const char *source) 
+{ 
+  return 0; 
+}
+
+void BB_shader::enable() { }
+void BB_shader::disable() { }
+void BB_shader::set_eye(const Vec3 &eye) { }
+void BB_shader::set_granulation(const float phase, const float amplitude,
+				const float period) { }
+void BB_shader::set_vertex(const Vec3 &normal, const float temp, 
+			   const float t_irr, const float gran_phase1, 
+			   const float gran_phase2, const float gran_frac) { }
+
+#endif
@@ -0,0 +1,96 @@
+/*
+  GLSL program to calculate black body colours on the GPU
+  
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _BBSHADER_H
+#define _BBSHADER_H
+
+#ifdef __APPLE__
+	#include <GLUT/glut.h>
+#else
+	#include <GL/glut.h>
+#endif
+
+#include "bbcolormodel.h"
+#include "mathvec.h"
+
+#include "binsim_stdinc.h"
+
+/*****************************************************************************/
+
+/*
+  Shader program implementing BB_color_model.  Each vertex supplies a
+  normal, a temperature and irradiation temperature, and optionally
+  granulation phases.  Granulation is applied per vertex, while limb
+  darkening and the conversion to RGB are evaluated per pixel.  Not
+  available if compiled with -DNOGLEXT.
+*/
+class BB_shader {
+  // Program and uniform locations
+  GLuint program;
+  GLint eye_loc, phase_loc, gran_amp_loc, gran_period_loc;
+
+  // Flag for successful compilation
+  bool ready;
+
+  // Compile one shader stage, returning 0 on failure
+  GLuint compile(const GLenum type, const char *source);
+
+  // Not copyable
+  BB_shader(const BB_shader&);
+  BB_shader& operator= (const BB_shader&);
+public:
+  // Constructor and destructor.  Requires a current OpenGL context
+  BB_shader(const BB_color_model &cm);
+  ~BB_shader();
+
+  // Did the program compile and link?
+  bool is_ready() { return ready; }
+
+  // Take the constants of the colour model, e.g. after its brightness
+  // or contrast has changed
+  void set_colour_model(const BB_color_model &cm);
+
+  // Start and stop using the program for drawing
+  void enable();
+  void disable();
+
+  // Direction to the observer, in the same frame as the normals
+  void set_eye(const Vec3 &eye);
+
+  // Granulation at the current phase.  amplitude 0 turns it off
+  void set_granulation(const float phase, const float amplitude, 
+		       const float period);
+
+  // Supply the inputs for the next vertex
+  static void set_vertex(const Vec3 &normal, const float temp, 
+			 const float t_irr = 0.0f, 
+			 const float gran_phase1 = 0.0f, 
+			 const float gran_phase2 = 0.0f, 
+			 const float gran_frac = 0.0f);
+};
+
+/*****************************************************************************/
+
+#endif
@@ -31,6 +31,12 @@
 #include "binary3d.h"
 #include "constants.h"
 #include "errmsg.h"
+#include "random_stream.h"
+#include "stringutil.h"
+#include "thread_pool.h"
+#include "vertex_logger.h"
+
+extern Vertex_logger *vertex_logger;
 
 using std::cout;
 
@@ -39,7 +45,8 @@ using std::cout;
 /*
   Constructor
 */
-Binary_3d::Binary_3d(Key_list &params, vector<float> phase1) 
+Binary_3d::Binary_3d(Key_list &params, vector<float> phase1,
+		     Stream_cache *shared_streams) 
 { 
   cout << "Extracting binary options...\n";
   get_params(params);
@@ -47,40 +54,108 @@ Binary_3d::Binary_3d(Key_list &params, vector<float> phase1)
   // Save pointer to phases
   phase = phase1;
 
+  // Nothing is built yet
+  lobe1 = lobe2 = 0;
+  disc = 0;
+  transparent_disc = 0;
+  stream = 0;
+  hot_spot = 0;
+  corona1 = corona2 = stellar_wind = 0;
+  jet = 0;
+  streams = 0;
+  own_streams = false;
+  cm = 0;
+  shader = 0;
+  roche_atlas = 0;
+
+  // Release whatever was built if the rest cannot be
+  try { build(params, shared_streams); }
+  catch (...) {
+    release();
+    throw;
+  }
+}
+
+/*
+  Build the components, sharing the given cache of stream
+  trajectories if there is one
+*/
+void Binary_3d::build(Key_list &params, Stream_cache *shared_streams)
+{
+  // Use the shared stream cache if given, otherwise one of our own
+  own_streams = (shared_streams == 0);
+  streams = own_streams ? new Stream_cache : shared_streams;
+
+  // Select method for stream trajectory integration
+  streams->set_method(stream_integrator);
+
   // Create color model
-  BB_color_model cm(params);
+  cm = new BB_color_model(params);
+
+  // Load Roche lobe shape table
+  if (roche_atlas_file != "") {
+    cout << "Loading Roche lobe atlas...\n";
+    roche_atlas = new Roche_atlas(roche_atlas_file);
+    if (roche_atlas->get_max_error() > roche_atlas_tol) {
+      cout << "   Atlas error " << roche_atlas->get_max_error() 
+	   << " exceeds ROCHE_ATLAS_TOL - Solving for lobe shapes\n";
+      delete roche_atlas;
+      roche_atlas = 0;
+    }
+  }
+
+  // The components are independent of each other, so build them
+  // concurrently, and the larger ones share out their own rows over
+  // the same threads.  Each has its own random number stream so that
+  // the result does not depend on the order in which they are built.
+  Random_stream lobe1_random(seed, 1), lobe2_random(seed, 2);
+  Random_stream disc_random(seed, 3), transparent_disc_random(seed, 4);
+  Random_stream stream_random(seed, 5), hot_spot_random(seed, 6);
 
   // Create Primary Roche lobe object
   if (show_lobe1) {
     cout << "Creating primary lobe object...\n";
-    lobe1 = new Lobe_3d(lobe1_n_steps, phase, 1.0/q, inclination, period, m_prim,
-			lobe1_t_pole, lobe1_t_min, luminosity2, disc_eff_thick,
-		        lobe1_granulation, lobe1_granulation_period, 
-		        lobe1_fill, cm, true);
+    pool.add_task([&]() {
+	lobe1 = new Lobe_3d(lobe1_n_steps, phase, 1.0/q, inclination, period, 
+			    m_prim, lobe1_t_pole, lobe1_t_min, luminosity2, 
+			    disc_eff_thick, lobe1_granulation, 
+			    lobe1_granulation_period, lobe1_fill, *cm, true,
+			    pool, lobe1_random, roche_atlas);
+	lobe1->init_colours(colour_on_demand || use_shaders);
+      });
   }
   
   // Create Companion Roche lobe object
   if (show_lobe2) {
     cout << "Creating companion lobe object...\n";
-    lobe2 = new Lobe_3d(lobe2_n_steps, phase, q, inclination, period, m_prim,
-		       lobe2_t_pole, lobe2_t_min, luminosity1, disc_eff_thick,
-		       lobe2_granulation, lobe2_granulation_period, 
-		       lobe2_fill, cm, false);
+    pool.add_task([&]() {
+	lobe2 = new Lobe_3d(lobe2_n_steps, phase, q, inclination, period, 
+			    m_prim, lobe2_t_pole, lobe2_t_min, luminosity1, 
+			    disc_eff_thick, lobe2_granulation, 
+			    lobe2_granulation_period, lobe2_fill, *cm, false,
+			    pool, lobe2_random, roche_atlas);
+	lobe2->init_colours(colour_on_demand || use_shaders);
+      });
   }
   
   // Create disc object
   if (show_disc) {
     cout << "Creating disc object...\n";
-    disc = new Disc_3d(disc_n_steps, phase, q, inclination, period, m_prim,
-		       disc_geom_thick, disc_rad, disc_r_in, 
-		       disc_tout, disc_temp_grad, disc_beta, 
-		       hot_spot_temp, disc_n_flare, disc_flare_length, cm);
+    pool.add_task([&]() {
+	disc = new Disc_3d(disc_n_steps, phase, q, inclination, period, 
+			   m_prim, disc_geom_thick, disc_rad, disc_r_in, 
+			   disc_tout, disc_temp_grad, disc_beta, 
+			   hot_spot_temp, disc_n_flare, disc_flare_length, *cm,
+			   *streams, pool, disc_random);
+	disc->init_colours(colour_on_demand || use_shaders);
+      });
   }
   
   // Create optically thin disc object
   if (show_transparent_disc) {
     cout << "Creating optically thin disc object...\n";
-    transparent_disc = new Transparent_disc_3d(transparent_disc_n_steps, 
+    pool.add_task([&]() {
+	transparent_disc = new Transparent_disc_3d(transparent_disc_n_steps, 
 			   phase, q, inclination, period, m_prim, 
                            transparent_disc_geom_thick, transparent_disc_rad, 
                            transparent_disc_r_in, transparent_disc_beta,
@@ -89,83 +164,218 @@ Binary_3d::Binary_3d(Key_list &params, vector<float> phase1)
 			   transparent_disc_n_flare, 
 			   transparent_disc_flare_length,
 			   hot_spot_red, hot_spot_green, hot_spot_blue,
-			   transparent_disc_hot_opacity);
+			   transparent_disc_hot_opacity, *streams, pool,
+			   transparent_disc_random);
+	transparent_disc->init_colours(colour_on_demand || use_shaders);
+      });
   }
 
   // Create stream object
   if (show_stream) { 
     cout << "Creating stream object...\n";
+    pool.add_task([&]() {
 #ifdef WIREFRAME
-    stream = new Stream_3d(8, phase, q, inclination, m_prim, period, 
-			   stream_disc_rad, lobe2_t_pole, stream_max_thick, 
-			   stream_open_angle, 
-			   stream_red, stream_green,
-			   stream_blue, stream_opacity);
+	stream = new Stream_3d(8, phase, q, inclination, m_prim, period, 
+			       stream_disc_rad, lobe2_t_pole, stream_max_thick, 
+			       stream_open_angle, 
+			       stream_red, stream_green,
+			       stream_blue, stream_opacity, *streams,
+			       stream_random);
 #else
-    stream = new Stream_3d(20, phase, q, inclination, m_prim, period, 
-			   stream_disc_rad, lobe2_t_pole, stream_max_thick, 
-			   stream_open_angle, 
-			   stream_red, stream_green,
-			   stream_blue, stream_opacity);
+	stream = new Stream_3d(20, phase, q, inclination, m_prim, period, 
+			       stream_disc_rad, lobe2_t_pole, stream_max_thick, 
+			       stream_open_angle, 
+			       stream_red, stream_green,
+			       stream_blue, stream_opacity, *streams,
+			       stream_random);
 #endif
+	stream->init_colours(colour_on_demand || use_shaders);
+      });
   }
 
   // Create hot spot object
   if (show_hot_spot) {
     cout << "Creating hot spot object...\n";
+    pool.add_task([&]() {
 #ifdef WIREFRAME
-    hot_spot = new Hot_spot_3d(2, phase, q, inclination, m_prim, period,
-			       hot_spot_disc_rad, hot_spot_size,
-			       hot_spot_red, hot_spot_green,
-			       hot_spot_blue, hot_spot_opacity,
-			       hot_spot_timescale);
-
+	hot_spot = new Hot_spot_3d(2, phase, q, inclination, m_prim, period,
+				   hot_spot_disc_rad, hot_spot_size,
+				   hot_spot_red, hot_spot_green,
+				   hot_spot_blue, hot_spot_opacity,
+				   hot_spot_timescale, *streams, 
+				   hot_spot_random);
 #else
-    hot_spot = new Hot_spot_3d(20, phase, q, inclination, m_prim, period,
-			       hot_spot_disc_rad, hot_spot_size,
-			       hot_spot_red, hot_spot_green,
-			       hot_spot_blue, hot_spot_opacity,
-			       hot_spot_timescale);
+	hot_spot = new Hot_spot_3d(20, phase, q, inclination, m_prim, period,
+				   hot_spot_disc_rad, hot_spot_size,
+				   hot_spot_red, hot_spot_green,
+				   hot_spot_blue, hot_spot_opacity,
+				   hot_spot_timescale, *streams, 
+				   hot_spot_random);
 #endif
+	hot_spot->init_colours(colour_on_demand || use_shaders);
+      });
   }
 
   // Create disc coronae
   if (show_corona1) {
     cout << "Creating corona object...\n";
-    corona1 = new Corona_3d(50, phase, q, inclination, corona1_rad, 
-			    corona1_red, corona1_green, corona1_blue,
-			    corona1_opacity, corona1_exp);
+    pool.add_task([&]() {
+	corona1 = new Corona_3d(50, phase, q, inclination, corona1_rad, 
+				corona1_red, corona1_green, corona1_blue,
+				corona1_opacity, corona1_exp);
+	corona1->init_colours(colour_on_demand || use_shaders);
+      });
   }
 
   if (show_corona2) {
     cout << "Creating corona object...\n";
-    corona2 = new Corona_3d(50, phase, q, inclination, corona2_rad, 
-			    corona2_red, corona2_green, corona2_blue,
-			    corona2_opacity, corona2_exp);
+    pool.add_task([&]() {
+	corona2 = new Corona_3d(50, phase, q, inclination, corona2_rad, 
+				corona2_red, corona2_green, corona2_blue,
+				corona2_opacity, corona2_exp);
+	corona2->init_colours(colour_on_demand || use_shaders);
+      });
   }
 
   // Create stellar wind
   if (show_stellar_wind) {
     cout << "Creating stellar wind object...\n";
-    stellar_wind = new Corona_3d(120, phase, q, inclination, stellar_wind_rad, 
-				 stellar_wind_red, stellar_wind_green, 
-				 stellar_wind_blue, stellar_wind_opacity, 
-				 stellar_wind_exp, true);
+    pool.add_task([&]() {
+	stellar_wind = new Corona_3d(120, phase, q, inclination, 
+				     stellar_wind_rad, stellar_wind_red, 
+				     stellar_wind_green, stellar_wind_blue, 
+				     stellar_wind_opacity, stellar_wind_exp, 
+				     true);
+	stellar_wind->init_colours(colour_on_demand || use_shaders);
+      });
   }
 
   // Create jet
   if (show_jet) {
     cout << "Creating jet object...\n";
-    jet = new Jet_3d(60, phase, q, inclination, jet_opening_angle, 
-		     jet_red1, jet_green1, jet_blue1, 
-		     jet_red2, jet_green2, jet_blue2, 
-		     jet_opacity, jet_exp, 
-		     jet_inc, jet_phi);
+    pool.add_task([&]() {
+	jet = new Jet_3d(60, phase, q, inclination, jet_opening_angle, 
+			 jet_red1, jet_green1, jet_blue1, 
+			 jet_red2, jet_green2, jet_blue2, 
+			 jet_opacity, jet_exp,
+			 jet_inc, jet_phi);
+	jet->init_colours(colour_on_demand || use_shaders);
+      });
   }
+
+  // Wait for all components to be built
+  pool.wait();
+
+  vector<Object_3d*> objects = get_objects();
+  for (unsigned i = 0 ; i < objects.size() ; i++) 
+    objects[i]->set_vertex_buffers(use_vertex_buffers);
+}
+
+/*
+  Release the components and the resources they share.  Needs the
+  OpenGL context they were drawn in to be current.
+*/
+Binary_3d::~Binary_3d()
+{
+  release();
+}
+
+/*
+  Release the components and the resources they share, including any
+  left partly built
+*/
+void Binary_3d::release()
+{
+  vector<Object_3d*> objects = get_objects();
+  for (unsigned i = 0 ; i < objects.size() ; i++) delete objects[i];
+
+  delete cm;
+  delete shader;
+  delete roche_atlas;
+  if (own_streams) delete streams;
 }
 
 /*****************************************************************************/
 
+/*
+  Identify whether a keyword changes only the view of the binary, so
+  that the components need not be rebuilt when it changes
+*/
+Binary_3d::Stage Binary_3d::stage(const string key)
+{
+  if (key == "INCLINATION" || key == "BRIGHTNESS" || key == "CONTRAST")
+    return VIEW;
+  else
+    return MODEL;
+}
+
+/*
+  Show the same components from a new inclination or with a new
+  brightness and contrast.  Only the colours are recalculated.
+*/
+void Binary_3d::update_view(Key_list &params)
+{
+  // Check every value before changing any, so that the view is left
+  // as it was if one is out of range
+  const float inclination1 = get_inclination(params);
+  float brightness, contrast;
+  BB_color_model::get_brightness_contrast(params, brightness, contrast);
+
+  cm->set_brightness_contrast(brightness, contrast);
+  if (shader) shader->set_colour_model(*cm);
+
+  set_inclination(inclination1);
+}
+
+/*
+  Show the same components from a new inclination, recalculating only
+  their colours
+*/
+void Binary_3d::set_inclination(const float inclination1)
+{
+  inclination = inclination1;
+
+  vector<Object_3d*> objects = get_objects();
+  pool.parallel_for(0, objects.size(), [&](int i) {
+      objects[i]->set_inclination(inclination);
+      objects[i]->refresh_colours();
+    });
+}
+
+/*
+  Move one phase to a new value, e.g. while the phase is changed
+  continuously by hand.  Only the colours of that phase are
+  recalculated.
+*/
+void Binary_3d::set_phase(const int phase_index, const float phase1)
+{
+  phase[phase_index] = phase1;
+
+  vector<Object_3d*> objects = get_objects();
+  pool.parallel_for(0, objects.size(), [&](int i) {
+      objects[i]->set_phase(phase_index, phase1);
+    });
+}
+
+/*****************************************************************************/
+
+/*
+  Prepare to be drawn in several OpenGL contexts at once.  This is
+  only possible if drawing reads the components without changing
+  them, so colours must be calculated in advance on the CPU.  Vertex
+  buffers belong to a single context, so are not used.
+*/
+bool Binary_3d::prepare_concurrent_drawing()
+{
+  if (colour_on_demand || use_shaders || vertex_logger) return false;
+
+  vector<Object_3d*> objects = get_objects();
+  for (unsigned i = 0 ; i < objects.size() ; i++) 
+    objects[i]->set_vertex_buffers(false);
+
+  return true;
+}
+
 /*
   Draw binary components
 */
@@ -181,6 +391,17 @@ void Binary_3d::draw(int phase_index)
   glRotatef(-inclination, 1.0f, 0.0f, 0.0f);
   glRotatef(angle, 0.0f, 0.0f, 1.0f);
 
+  if (use_shaders && shader == 0) init_shader();
+
+  // In on demand mode, calculate colours of all components for this
+  // phase together, one component per thread
+  if (colour_on_demand || use_shaders) {
+    vector<Object_3d*> objects = get_objects();
+    pool.parallel_for(0, objects.size(), [&](int i) {
+	objects[i]->update_colours(phase_index);
+      });
+  }
+
   // Draw selected components
   if (show_lobe1) lobe1->draw(phase_index);
   if (show_lobe2) lobe2->draw(phase_index);
@@ -219,8 +440,61 @@ void Binary_3d::draw(int phase_index)
   }
 }
 
+/*
+  Create the shader and hand it to the components that can use it.
+  If it cannot be compiled, colours are calculated as each phase is
+  drawn instead.
+*/
+void Binary_3d::init_shader()
+{
+  cout << "Compiling shaders...\n";
+  shader = new BB_shader(*cm);
+  if (!shader->is_ready()) {
+    cout << "   Shaders unavailable - calculating colours on the CPU\n";
+    return;
+  }
+
+  vector<Object_3d*> objects = get_objects();
+  for (unsigned i = 0 ; i < objects.size() ; i++) objects[i]->use_shader(shader);
+}
+
+/*
+  Return the components currently shown
+*/
+vector<Object_3d*> Binary_3d::get_objects()
+{
+  vector<Object_3d*> objects;
+
+  if (show_lobe1) objects.push_back(lobe1);
+  if (show_lobe2) objects.push_back(lobe2);
+  if (show_disc) objects.push_back(disc);
+  if (show_transparent_disc) objects.push_back(transparent_disc);
+  if (show_stream) objects.push_back(stream);
+  if (show_hot_spot) objects.push_back(hot_spot);
+  if (show_corona1) objects.push_back(corona1);
+  if (show_corona2) objects.push_back(corona2);
+  if (show_stellar_wind) objects.push_back(stellar_wind);
+  if (show_jet) objects.push_back(jet);
+
+  return objects;
+}
+
 /*****************************************************************************/
 
+/*
+  Read the inclination, which can be changed without rebuilding the
+  components, and check it is in range
+*/
+float Binary_3d::get_inclination(Key_list &params)
+{
+  // Determine inclination - no default, must be > -90.0, < 90.0
+  float inclination = params.get_float("INCLINATION");  
+  if (inclination < 0.0f || inclination > 90.0f)
+    throw Key_list::Value_out_of_range_exception("INCLINATION", 
+						 "0.0-90.0");
+  return inclination;
+}
+
 /*
   Read in parameters from file
 */
@@ -312,11 +586,47 @@ void Binary_3d::get_params(Key_list &params)
   if (m_prim <= 0.0f) 
     throw Key_list::Value_out_of_range_exception("M1", "> 0.0");
 
-  // Determine inclination - no default, must be > -90.0, < 90.0
-  inclination = params.get_float("INCLINATION");  
-  if (inclination < 0.0f || inclination > 90.0f)
-    throw Key_list::Value_out_of_range_exception("INCLINATION", 
-						 "0.0-90.0");
+  inclination = get_inclination(params);
+
+  /***************************************************************************/
+
+  // Determine seed for random structure (granulation, flares and
+  // stream and hot spot variability) - default 0
+  try { seed = params.get_int("SEED"); }
+  catch (Key_list::Key_not_found_exception) {
+    seed = 0;
+    print_default_key_msg("SEED", "0");
+  }
+
+  // Calculate colours as each phase is drawn rather than for all
+  // phases in advance?  Default false
+  try { colour_on_demand = params.get_bool("COLOUR_ON_DEMAND");}   
+  catch (Key_list::Key_not_found_exception) {
+    colour_on_demand = false;
+    print_default_key_msg("COLOUR_ON_DEMAND", "False");
+  } 
+
+  // Calculate colours of stars and discs on the GPU?  Not used in
+  // wireframe or vertex logging modes, where colours are needed on
+  // the CPU.  Default false
+  try { use_shaders = params.get_bool("SHADERS");}   
+  catch (Key_list::Key_not_found_exception) {
+    use_shaders = false;
+    print_default_key_msg("SHADERS", "False");
+  } 
+#ifdef WIREFRAME
+  use_shaders = false;
+#endif
+  if (vertex_logger) use_shaders = false;
+
+  // Draw components from vertex buffers, with one OpenGL call each,
+  // rather than point by point?  Components drawn with shaders are
+  // always sent point by point.  Default true
+  try { use_vertex_buffers = params.get_bool("VERTEX_BUFFERS");}   
+  catch (Key_list::Key_not_found_exception) {
+    use_vertex_buffers = true;
+    print_default_key_msg("VERTEX_BUFFERS", "True");
+  } 
 
   /***************************************************************************/
 
@@ -469,6 +779,32 @@ void Binary_3d::get_params(Key_list &params)
 
   /***************************************************************************/
 
+  // Determine Roche lobe shape table parameters
+  roche_atlas_file = "";
+  roche_atlas_tol = 0.0f;
+  if (show_lobe1 || show_lobe2) {
+    // Shape table file - default none, solve for all lobe shapes
+    try { roche_atlas_file = params.get_value("ROCHE_ATLAS"); }
+    catch (Key_list::Key_not_found_exception) {
+      print_default_key_msg("ROCHE_ATLAS", "none");
+    }
+
+    // Accepted interpolation error in units of binary separation -
+    // default 1e-3, must be > 0.0
+    if (roche_atlas_file != "") {
+      try { roche_atlas_tol = params.get_float("ROCHE_ATLAS_TOL"); }
+      catch (Key_list::Key_not_found_exception) {
+	roche_atlas_tol = 1e-3f;
+	print_default_key_msg("ROCHE_ATLAS_TOL", "1e-3");
+      }
+      if (roche_atlas_tol <= 0.0f)
+	throw Key_list::Value_out_of_range_exception("ROCHE_ATLAS_TOL", 
+						     "> 0.0");
+    }
+  }
+
+  /***************************************************************************/
+
   // Determine disc parameters
   if (show_disc) {
     // Determine disc grid step - default 60, must be > 2
@@ -779,6 +1115,27 @@ void Binary_3d::get_params(Key_list &params)
 
   /***************************************************************************/
 
+  // Determine stream integration method for components that follow the
+  // stream trajectory - default RK45, must be RK45 or EULER
+  stream_integrator = Stream::RK45;
+  if (show_disc || show_transparent_disc || show_stream || show_hot_spot) {
+    try { 
+      string method = params.get_value("STREAM_INTEGRATOR");
+      String_util::string_toupper(method);
+      String_util::strip_whitespace(method);
+
+      if (method == "RK45") stream_integrator = Stream::RK45;
+      else if (method == "EULER") stream_integrator = Stream::EULER;
+      else throw Key_list::Value_out_of_range_exception("STREAM_INTEGRATOR",
+							"RK45 or EULER");
+    }
+    catch (Key_list::Key_not_found_exception) {
+      print_default_key_msg("STREAM_INTEGRATOR", "RK45");
+    }
+  }
+
+  /***************************************************************************/
+
   // Determine hot spot parameters
   if (show_hot_spot) {
     // Hot spot size - no default, must be > 0.0
@@ -31,6 +31,7 @@
 #include <vector>
 
 #include "bbcolormodel.h"
+#include "bbshader.h"
 #include "constants.h"
 #include "corona3d.h"
 #include "disc3d.h"
@@ -38,7 +39,10 @@
 #include "jet3d.h"
 #include "keyword.h"
 #include "lobe3d.h"
+#include "roche_atlas.h"
+#include "stream.h"
 #include "stream3d.h"
+#include "thread_pool.h"
 #include "transparent_disc3d.h"
 
 #include "binsim_stdinc.h"
@@ -65,6 +69,22 @@ public:
   float lobe2_fill, lobe2_t_pole, lobe2_t_min;
   float lobe2_granulation, lobe2_granulation_period;
 
+  // Roche lobe shape table parameters
+  string roche_atlas_file;
+  float roche_atlas_tol;
+
+  // Seed for random structure
+  int seed;
+
+  // Calculate colours as each phase is drawn rather than in advance
+  bool colour_on_demand;
+
+  // Calculate colours of stars and discs on the GPU
+  bool use_shaders;
+
+  // Draw components from buffers held by OpenGL
+  bool use_vertex_buffers;
+
   // Irradiation parameters
   float luminosity1, luminosity2, disc_eff_thick;
 
@@ -87,6 +107,7 @@ public:
   float stream_max_thick, stream_open_angle;
   float stream_red, stream_green, stream_blue, stream_opacity;
   float stream_disc_rad;
+  int stream_integrator;
 
   // Hot spot parameters
   float hot_spot_size, hot_spot_red, hot_spot_green, hot_spot_blue;
@@ -125,14 +146,66 @@ public:
   Corona_3d *stellar_wind;
   Jet_3d *jet;
 
-  // Constructor
-  Binary_3d(Key_list &params, vector<float> phase1);
+  // Table of precomputed Roche lobe shapes, if one is in use
+  Roche_atlas *roche_atlas;
+
+  // Stream trajectories shared between components, and with other
+  // binaries if the cache was given to the constructor
+  Stream_cache *streams;
+  bool own_streams;
+
+  // Colour model for stars and discs
+  BB_color_model *cm;
+
+  // Threads used to build components and calculate their colours
+  Thread_pool pool;
+
+  // Shader calculating black body colours, created when first drawn
+  BB_shader *shader;
+
+  // Components currently shown
+  vector<Object_3d*> get_objects();
+
+  // Build the components and the resources they share, and release
+  // them again
+  void build(Key_list &params, Stream_cache *shared_streams);
+  void release();
+
+  // Constructor, optionally sharing a cache of stream trajectories
+  Binary_3d(Key_list &params, vector<float> phase1, 
+	    Stream_cache *shared_streams = 0);
+
+  ~Binary_3d();
 
   // Draw binary components
   void draw(int phase_index);
 
+  // Set up the shader, needing a current OpenGL context
+  void init_shader();
+
+  // Prepare to be drawn in several OpenGL contexts at once, returning
+  // false if not possible
+  bool prepare_concurrent_drawing();
+
+  // Keywords either define the components themselves or only how
+  // they are viewed
+  enum Stage {VIEW, MODEL};
+  static Stage stage(const string key);
+
+  // Show the same components with new view parameters
+  void update_view(Key_list &params);
+
+  // Show the same components from a new inclination
+  void set_inclination(const float inclination1);
+
+  // Show the same components at a new value of one phase
+  void set_phase(const int phase_index, const float phase1);
+
   // Read in parameters from file
   void get_params(Key_list &params);
+
+  // Read and check the inclination in a parameter list
+  static float get_inclination(Key_list &params);
 };
 
 /*****************************************************************************/
@@ -23,6 +23,10 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>. 
 */
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
 #ifdef __APPLE__
@@ -38,17 +42,27 @@
 #include "vertex_logger.h"
 
 using std::cout;
+using std::min;
 
-Vertex_logger *vertex_logger;
+Vertex_logger *vertex_logger = 0;
 
 /*****************************************************************************/
 
 /*
   Constructor
 */
-Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
+Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1, 
+		 Stream_cache *streams)
 {
   cout << "Extracting rendering options...\n";
+
+  // Components created below or when OpenGL is set up
+  owns_model = true;
+  sky = 0;
+  animator = 0;
+  scene_list = 0;
+  supersampler = 0;
+  draft = false;
     
   // Image width - must be positive
   width = params.get_int("WIDTH"); 
@@ -60,6 +74,20 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
   if (height < 1) 
     throw Key_list::Value_out_of_range_exception("HEIGHT", ">= 1");
 
+  // Size of tiles when rendering in tiles - default 0 (no tiling),
+  // must be >= 0.  Only one tile is held in the OpenGL buffer at a
+  // time, so images can be larger than OpenGL allows.
+  try { tile_size = params.get_int("TILE_SIZE"); }
+  catch (Key_list::Key_not_found_exception) {
+    tile_size = 0;
+    print_default_key_msg("TILE_SIZE", "0");
+  }
+  if (tile_size < 0) 
+    throw Key_list::Value_out_of_range_exception("TILE_SIZE", ">= 0");
+
+  render_width = (tile_size > 0) ? tile_size : width;
+  render_height = (tile_size > 0) ? tile_size : height;
+
   // Derive aspect ratio of image
   aspect_ratio = ((float) width) / ((float) height);
 
@@ -81,7 +109,27 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
     antialias = hq_antialias = false;
   }
   
+  // Antialiasing method - ACCUM (jittered renders averaged in the
+  // accumulation buffer, the default) or SUPERSAMPLE (one render at
+  // higher resolution, filtered down)
+  supersample = false;
   if (antialias) {
+    try { 
+      string method = params.get_value("AA_METHOD");
+      String_util::string_toupper(method);
+      String_util::strip_whitespace(method);
+
+      if (method == "ACCUM") supersample = false;
+      else if (method == "SUPERSAMPLE") supersample = true;
+      else throw Key_list::Value_out_of_range_exception("AA_METHOD",
+							"ACCUM or SUPERSAMPLE");
+    }
+    catch (Key_list::Key_not_found_exception) {
+      print_default_key_msg("AA_METHOD", "ACCUM");
+    }
+  }
+
+  if (antialias && !supersample) {
     n_samples = params.get_int("SAMPLES");
     if (n_samples != 2 && n_samples != 4)
       throw Key_list::Value_out_of_range_exception("SAMPLES", 
@@ -89,6 +137,31 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
     n_samples *= n_samples;
   }
 
+  // Supersampling factor in each direction - no default, must be 1-16
+  if (supersample) {
+    aa_factor = params.get_int("SAMPLES");
+    if (aa_factor < 1 || aa_factor > 16)
+      throw Key_list::Value_out_of_range_exception("SAMPLES", "1-16");
+
+    // Filter used to reduce the supersampled image - BOX (default),
+    // TENT or LANCZOS
+    aa_filter = Supersampler::BOX;
+    try { 
+      string filter = params.get_value("AA_FILTER");
+      String_util::string_toupper(filter);
+      String_util::strip_whitespace(filter);
+
+      if (filter == "BOX") aa_filter = Supersampler::BOX;
+      else if (filter == "TENT") aa_filter = Supersampler::TENT;
+      else if (filter == "LANCZOS") aa_filter = Supersampler::LANCZOS;
+      else throw Key_list::Value_out_of_range_exception("AA_FILTER",
+						     "BOX, TENT or LANCZOS");
+    }
+    catch (Key_list::Key_not_found_exception) {
+      print_default_key_msg("AA_FILTER", "BOX");
+    }
+  }
+
   // Animation switch
   try { anim = params.get_bool("ANIM"); }
   catch (Key_list::Key_not_found_exception) {
@@ -129,6 +202,20 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
     phase_index = 0;
   }
 
+  // Can the phase and view be changed by hand?  Default false.  Only
+  // possible for still images drawn whole.
+  try { interactive = params.get_bool("INTERACTIVE"); }
+  catch (Key_list::Key_not_found_exception) {
+    interactive = false;
+    print_default_key_msg("INTERACTIVE", "False");
+  }
+  if (interactive && anim)
+    throw Key_list::Value_out_of_range_exception("INTERACTIVE", 
+						 "False for animations");
+  if (interactive && tile_size > 0)
+    throw Key_list::Value_out_of_range_exception("TILE_SIZE", 
+						 "0 when Interactive");
+
   // Get image scale - must be positive
   try { scale = 1.0f / params.get_float("SCALE"); }
   catch (Key_list::Key_not_found_exception) {
@@ -138,11 +225,6 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
   if (scale <= 0.0f)
     throw Key_list::Value_out_of_range_exception("SCALE", "> 0.0");
    
-  // Derive size of viewport
-  world_width = scale * sqrt(aspect_ratio);
-  world_height = scale / sqrt(aspect_ratio);    
-  world_pixsize = world_width / width;
-  
   // Get x centre of viewport
   try { world_centre_x = -params.get_float("XOFFSET"); }   
   catch (Key_list::Key_not_found_exception) {
@@ -157,11 +239,8 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
     print_default_key_msg("YOFFSET", "0.0");
   } 
 
-  // Derive boundaries of viewport
-  world_min_x = world_centre_x - world_width / 2.0f;
-  world_max_x = world_centre_x + world_width / 2.0f;
-  world_min_y = world_centre_y - world_height / 2.0f;
-  world_max_y = world_centre_y + world_height / 2.0f;
+  // Derive size and boundaries of viewport
+  set_world_window();
   
   // Should an image be saved?
   try { save = params.get_bool("SAVE"); }
@@ -183,26 +262,7 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
 #endif
     }
 
-    // Extract 3 and 4 character extensions
-    string ext3 = imagefile.substr(imagefile.length()-3,3);
-    string ext4 = imagefile.substr(imagefile.length()-4,4);
-
-    // Identify extensions
-#ifndef NOJPEG
-    if (ext3 == "jpg" || ext3 == "JPG" || ext4 == "jpeg" || ext4 == "JPEG")
-      output_format = Image_writer::JPEG;
-    else 
-#endif
-    if (ext3 == "ppm" || ext3 == "PPM")
-      output_format = Image_writer::PPM;
-    else {
-#ifndef NOJPEG
-      cout << "Only JPEG and PPM support is available\n";
-#else
-      cout << "Only PPM support is available\n";
-#endif
-      throw Key_list::File_format_exception(imagefile);
-    }
+    output_format = image_format(imagefile);
 
 #ifndef NOJPEG
     // Get output JPEG quality
@@ -218,43 +278,88 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
 #endif    
 
     if (anim) {
-      // Get directory for animation images
-      try { anim_root = params.get_value("ANIM_ROOT"); }
+      // Stream frames as YUV4MPEG2 video instead of saving images -
+      // default none.  A filename of - selects standard output.
+      try { video_file = params.get_value("Y4M_FILE"); }
       catch (Key_list::Key_not_found_exception) {
-	anim_root = "";
-	print_default_key_msg("ANIM_ROOT", "");
+	video_file = "";
       }
 
-      // Ensure anim_root has the correct trailing slash
+      if (video_file == "") {
+	// Get directory for animation images
+	try { anim_root = params.get_value("ANIM_ROOT"); }
+	catch (Key_list::Key_not_found_exception) {
+	  anim_root = "";
+	  print_default_key_msg("ANIM_ROOT", "");
+	}
+
+	// Ensure anim_root has the correct trailing slash
 #ifdef WIN32
-      char delimiter = '\\';
+	char delimiter = '\\';
 #else
-      char delimiter = '/';
+	char delimiter = '/';
 #endif
 
-      if (anim_root.length() == 0) {
-	anim_root = ".";
-	anim_root += delimiter;
-      } else {
-	if (anim_root[anim_root.length()-1] == '\\' ||
-	    anim_root[anim_root.length()-1] == '/')
-	  anim_root[anim_root.length()-1] = delimiter;
-	else anim_root += delimiter;
+	if (anim_root.length() == 0) {
+	  anim_root = ".";
+	  anim_root += delimiter;
+	} else {
+	  if (anim_root[anim_root.length()-1] == '\\' ||
+	      anim_root[anim_root.length()-1] == '/')
+	    anim_root[anim_root.length()-1] = delimiter;
+	  else anim_root += delimiter;
+	}
+      }
+
+      // Number of threads writing frames in the background - default
+      // 1, must be >= 0.  With no threads frames are written by the
+      // renderer.
+      int encoder_threads;
+      try { encoder_threads = params.get_int("ENCODER_THREADS"); }
+      catch (Key_list::Key_not_found_exception) {
+	encoder_threads = 1;
+	print_default_key_msg("ENCODER_THREADS", "1");
+      }
+      if (encoder_threads < 0) 
+	throw Key_list::Value_out_of_range_exception("ENCODER_THREADS", 
+						     ">= 0");
+
+      // Number of frames that may wait to be written before rendering
+      // waits - default 4, must be >= 1
+      int encoder_queue;
+      try { encoder_queue = params.get_int("ENCODER_QUEUE"); }
+      catch (Key_list::Key_not_found_exception) {
+	encoder_queue = 4;
+	print_default_key_msg("ENCODER_QUEUE", "4");
       }
+      if (encoder_queue < 1) 
+	throw Key_list::Value_out_of_range_exception("ENCODER_QUEUE", 
+						     ">= 1");
+
+      writer1->set_encoder(encoder_threads, encoder_queue);
+
+      if (video_file != "") {
+	// Tiles are written as still images
+	if (tile_size > 0)
+	  throw Key_list::Value_out_of_range_exception("TILE_SIZE", 
+						       "0 with Y4M_File");
 
-      // Create movie maker object
-      animator = new Movie_maker(params);
+	// Frames per second of video - default 25, must be >= 1
+	int frame_rate;
+	try { frame_rate = params.get_int("Y4M_FRAME_RATE"); }
+	catch (Key_list::Key_not_found_exception) {
+	  frame_rate = 25;
+	  print_default_key_msg("Y4M_FRAME_RATE", "25");
+	}
+	if (frame_rate < 1) 
+	  throw Key_list::Value_out_of_range_exception("Y4M_FRAME_RATE", 
+						       ">= 1");
+
+	writer1->open_video(video_file, frame_rate);
+      }
     }
   }
 
-  // Should a vertex log file be created?
-  try { vertex_log = params.get_bool("VERTEX_LOG"); }
-  catch (Key_list::Key_not_found_exception) {
-    vertex_log = false;
-  }
-  if (vertex_log) vertex_logger = new Vertex_logger();
-  else vertex_logger = 0;
-  
   // Determine if background stars should be seen
   try { show_stars = params.get_bool("SHOW_STARS"); }
   catch (Key_list::Key_not_found_exception) {
@@ -262,18 +367,231 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
     print_default_key_msg("SHOW_STARS", "False");
   }
 
-  // Create starfield object
-  if (show_stars)
-    sky = new Star_sky(world_min_x, world_max_x, world_min_y, world_max_y, 
-		       params);
+  // Select the inclinations of a still image
+  select_views(params);
+
+  // Create movie maker, starfield and binary objects, releasing any
+  // already created if a later step fails
+  try {
+    if (anim && save && video_file == "") animator = new Movie_maker(params);
 
-  // Create binary object
-  binary = new Binary_3d(params, phase);
+    // Select the frames of an animation to be drawn
+    if (anim) select_frames(params);
+
+    if (show_stars)
+      sky = new Star_sky(world_min_x, world_max_x, world_min_y, world_max_y, 
+			 params);
+
+    binary = new Binary_3d(params, phase, streams);
+  }
+  catch (...) {
+    delete animator;
+    delete sky;
+    throw;
+  }
 
   // Save pointer to image writer
   writer = writer1;
 }
 
+/*
+  Constructor for a view of the same model drawn into another OpenGL
+  context, with its own image writer.  The context must be set up
+  with gl_setup_context.
+*/
+Bin_sim::Bin_sim(const Bin_sim &model, Image_writer *writer1)
+  : Bin_sim(model)
+{
+  writer = writer1;
+  owns_model = false;
+  scene_list = 0;
+  supersampler = 0;
+}
+
+/*
+  Release the OpenGL resources of this view, which must be current,
+  and the model unless it is shared with another view
+*/
+Bin_sim::~Bin_sim()
+{
+  if (scene_list) glDeleteLists(scene_list, 1);
+  delete supersampler;
+
+  if (owns_model) {
+    delete binary;
+    delete sky;
+    delete animator;
+  }
+}
+
+/*****************************************************************************/
+
+/*
+  Derive the size and boundaries of the part of the world shown from
+  the scale and centre
+*/
+void Bin_sim::set_world_window()
+{
+  // Derive size of viewport
+  world_width = scale * sqrt(aspect_ratio);
+  world_height = scale / sqrt(aspect_ratio);    
+  world_pixsize = world_width / width;
+
+  // Derive boundaries of viewport
+  world_min_x = world_centre_x - world_width / 2.0f;
+  world_max_x = world_centre_x + world_width / 2.0f;
+  world_min_y = world_centre_y - world_height / 2.0f;
+  world_max_y = world_centre_y + world_height / 2.0f;
+}
+
+/*
+  Change the phase drawn by hand.  The phase changes continuously
+  rather than stepping between precalculated phases, so only the
+  colours of the new phase are calculated.
+*/
+void Bin_sim::move_phase(const float d_phase)
+{
+  phase[phase_index] += d_phase;
+  binary->set_phase(phase_index, phase[phase_index]);
+}
+
+/*
+  Tilt the binary by hand, keeping the inclination within 0-90
+*/
+void Bin_sim::move_inclination(const float d_inclination)
+{
+  float inclination = binary->inclination + d_inclination;
+  if (inclination < 0.0f) inclination = 0.0f;
+  if (inclination > 90.0f) inclination = 90.0f;
+
+  binary->set_inclination(inclination);
+}
+
+/*
+  Zoom in (factor > 1) or out about the centre of the image
+*/
+void Bin_sim::zoom(const float factor)
+{
+  scale /= factor;
+  set_world_window();
+}
+
+/*
+  Move the image by a number of pixels, with y increasing downwards
+  as on screen
+*/
+void Bin_sim::pan(const int dx, const int dy)
+{
+  world_centre_x -= dx * world_pixsize;
+  world_centre_y += dy * world_pixsize;
+  set_world_window();
+}
+
+/*****************************************************************************/
+
+/*
+  Identify the format of an image file from its extension
+*/
+int Bin_sim::image_format(const string filename)
+{
+  // Extract 3 and 4 character extensions
+  string ext3 = filename.substr(filename.length()-3,3);
+  string ext4 = filename.substr(filename.length()-4,4);
+
+  // Identify extensions
+#ifndef NOJPEG
+  if (ext3 == "jpg" || ext3 == "JPG" || ext4 == "jpeg" || ext4 == "JPEG")
+    return Image_writer::JPEG;
+#endif
+  if (ext3 == "ppm" || ext3 == "PPM")
+    return Image_writer::PPM;
+
+#ifndef NOJPEG
+  cout << "Only JPEG and PPM support is available\n";
+#else
+  cout << "Only PPM support is available\n";
+#endif
+  throw Key_list::File_format_exception(filename);
+}
+
+/*
+  Draw the same model with new parameters, if they only change the
+  view of the binary and the image file it is saved to, if any.
+  Returns false, leaving everything unchanged, if the model must be
+  rebuilt.
+*/
+bool Bin_sim::update_view(Key_list &params, const vector<string> &changed)
+{
+  // Only still images can be drawn this way
+  if (!owns_model || anim) return false;
+
+  bool view_changed = false;
+  for (unsigned i = 0 ; i < changed.size() ; i++) {
+    if (changed[i] == "IMAGE_FILE") continue;
+    if (Binary_3d::stage(changed[i]) != Binary_3d::VIEW) return false;
+    view_changed = true;
+  }
+
+  // Save the new image if asked to, which must be in the same format.
+  // Saving cannot have been switched on, as Save is not a view
+  // keyword, so the format is known.
+  bool save1;
+  try { save1 = params.get_bool("SAVE"); }
+  catch (Key_list::Key_not_found_exception) {
+    save1 = false;
+  }
+
+  string filename = imagefile;
+  if (save1) {
+    try { filename = params.get_value("IMAGE_FILE"); }
+    catch (Key_list::Key_not_found_exception) {}
+    if (image_format(filename) != output_format) return false;
+  }
+
+  // The binary is left unchanged if the view is out of range
+  if (view_changed) {
+    cout << "Updating view of existing binary\n";
+    binary->update_view(params);
+  }
+
+  imagefile = filename;
+  save = save1;
+  return true;
+}
+
+/*
+  Check whether a parameter file streams video to standard output, in
+  which case messages must be sent elsewhere before any are written.
+  Errors in the file are left to be reported when it is read properly.
+*/
+bool Bin_sim::video_to_stdout(const string param_file)
+{
+  try {
+    Key_list params(param_file);
+    return params.get_bool("SAVE") && params.get_bool("ANIM") &&
+      params.get_value("Y4M_FILE") == "-";
+  }
+  catch (...) {
+    return false;
+  }
+}
+
+/*
+  Create the vertex log file if the parameters ask for one.  Every
+  model writes to the same log, which is read while drawing, so it is
+  created once before the first model rather than by each model.
+*/
+void Bin_sim::start_vertex_log(Key_list &params)
+{
+  bool vertex_log;
+  try { vertex_log = params.get_bool("VERTEX_LOG"); }
+  catch (Key_list::Key_not_found_exception) {
+    vertex_log = false;
+  }
+
+  if (vertex_log && vertex_logger == 0) vertex_logger = new Vertex_logger();
+}
+
 /*****************************************************************************/
 
 /*
@@ -281,14 +599,16 @@ Bin_sim::Bin_sim(Key_list &params, Image_writer *writer1)
 */
 void Bin_sim::gl_setup(const bool onscreen)
 {
-  // Set display mode
+  // Set display mode.  The accumulation buffer is not needed when
+  // supersampling.
+  bool accum = antialias && !supersample;
   if (onscreen) {
-    if (antialias) 
+    if (accum) 
       glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH | GLUT_RGB | GLUT_ACCUM);
     else 
       glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH | GLUT_RGB);
   } else {
-    if (antialias) 
+    if (accum) 
       glutInitDisplayMode(GLUT_DEPTH | GLUT_RGB | GLUT_ACCUM);
     else 
       glutInitDisplayMode(GLUT_DEPTH | GLUT_RGB);
@@ -296,14 +616,40 @@ void Bin_sim::gl_setup(const bool onscreen)
 
   // Create display window
   if (onscreen) {
-    glutInitWindowSize(width, height); 
+    glutInitWindowSize(render_width, render_height); 
     glutInitWindowPosition (0, 0);
     glutCreateWindow(Bin_sim_version::full_name.c_str());
   }
-  
+
+  gl_setup_context();
+}
+
+/*
+  Option dependent initialisation of the current OpenGL context
+*/
+void Bin_sim::gl_setup_context()
+{
+  bool accum = antialias && !supersample;
+
   // Clear buffers
   glClearColor(0.0,0.0,0.0,0.0);
-  if (antialias) glClearAccum(0.0,0.0,0.0,0.0);
+  if (accum) glClearAccum(0.0,0.0,0.0,0.0);
+
+  // Reserve display list for antialiasing passes
+  if (accum) scene_list = glGenLists(1);
+
+  // Create supersampled framebuffer
+  supersampler = 0;
+  if (supersample) {
+    supersampler = new Supersampler(render_width, render_height, aa_factor,
+				    aa_filter, binary->pool);
+    if (!supersampler->is_ready()) {
+      cout << "   Supersampling unavailable - antialiasing disabled\n";
+      delete supersampler;
+      supersampler = 0;
+      antialias = false;
+    }
+  }
 
   // Set rendering options
   glShadeModel(GL_SMOOTH);
@@ -317,6 +663,17 @@ void Bin_sim::gl_setup(const bool onscreen)
 #endif
  }
 
+/*
+  Prepare to draw frames in several views of this model at once.
+  Only possible for saved animations drawn without tiles from
+  components that are not changed by drawing.
+*/
+bool Bin_sim::prepare_concurrent_drawing()
+{
+  return anim && save && tile_size == 0 && 
+    binary->prepare_concurrent_drawing();
+}
+
 /*****************************************************************************/
 
 /*
@@ -337,22 +694,291 @@ void Bin_sim::gl_commands(void)
 */
 void Bin_sim::draw(const bool onscreen)
 {
+  // Ensure phase_index >= 0
+  if (phase_index < 0) phase_index = 0;
+
+  if (anim)
+    cout << "Frame " << frame_number[phase_index] << "\n";
+
+  // Draw the whole image, unless it is to be saved in tiles, in
+  // which case the display only shows a preview squeezed into one
+  // tile, or saved from several inclinations, which are drawn in turn
+  const bool drawn = (tile_size == 0 && inclinations.empty()) || !save;
+  if (drawn) render(world_min_x, world_max_x, world_min_y, world_max_y);
+
+  // Transfer current image to front buffer
+  if (onscreen && drawn) glutSwapBuffers();
+
+  // Save current frame if desired.  Only save once on first draw.
+  if (save) {
+    if (anim && video_file != "") {
+      // Add frame to video
+      writer->queue_frame("", Image_writer::Y4M);
+
+      // When last frame is written end the video and stop saving
+      if (last_frame()) finish_animation();
+    } else if (anim) {
+      // Construct image filenames
+      imagefile = anim_root + frame_filename(frame_number[phase_index]);
+      // Write animation frame.  Unless tiled, it may not be written
+      // until the next frame has been drawn.
+      if (tile_size > 0) save_image(imagefile, Image_writer::PPM);
+      else writer->queue_frame(imagefile, Image_writer::PPM);
+      //writer->write_jpeg(imagefile, jpeg_quality);
+
+      // When last frame is written make movie and stop saving
+      if (last_frame()) finish_animation();
+    } else if (!inclinations.empty()) {
+      // Write the still image seen from each inclination
+      save_views();
+      writer->flush();
+      save = false;
+    } else {
+      // Write still image
+      save_image(imagefile, output_format);
+      writer->flush();
+      save = false;
+    }
+  }
+
+  // Once saved in pieces, draw the whole image for display
+  if (onscreen && !drawn) {
+    render(world_min_x, world_max_x, world_min_y, world_max_y);
+    glutSwapBuffers();
+  }
+}
+
+/*
+  Draw a phase without displaying or saving it
+*/
+void Bin_sim::draw_phase(const int phase)
+{
+  phase_index = phase;
+  render(world_min_x, world_max_x, world_min_y, world_max_y);
+}
+
+/*
+  Save an animation frame drawn by a view of this model.  Frames must
+  be saved in order of phase.
+*/
+void Bin_sim::save_frame(unsigned char *pixels, const int phase)
+{
+  cout << "Frame " << frame_number[phase] << "\n";
+
+  if (video_file != "") 
+    writer->submit_frame(pixels, "", Image_writer::Y4M, 0);
+  else 
+    writer->submit_frame(pixels, 
+			 anim_root + frame_filename(frame_number[phase]),
+			 Image_writer::PPM, 0);
+
+  if (phase == n_phase - 1) finish_animation();
+}
+
+/*
+  Restrict an animation to the slice of frames given by FRAMES, as
+  start:end:stride with the end excluded and any part optional.  When
+  RESUME is set, frames whose images have already been saved are
+  skipped, though they remain part of the movie.  Frames keep their
+  numbers and phases, so a frame is the same whichever slice it is
+  drawn in.
+*/
+void Bin_sim::select_frames(Key_list &params)
+{
+  const int n_frame = phase.size();
+
+  // Slice of frames - default all
+  int slice[3] = {0, n_frame, 1};
+  try {
+    string frames = params.get_value("FRAMES");
+    vector<string> parts = String_util::split_string(frames, ':', true);
+    if (parts.size() < 2 || parts.size() > 3)
+      throw Key_list::File_format_exception("FRAMES = " + frames);
+
+    for (unsigned i = 0 ; i < parts.size() ; i++) {
+      char tail;
+      if (parts[i] != "" && 
+	  sscanf(parts[i].c_str(), "%d%c", &slice[i], &tail) != 1)
+	throw Key_list::File_format_exception("FRAMES = " + frames);
+    }
+  }
+  catch (Key_list::Key_not_found_exception) {}
+
+  const int start = slice[0], stride = slice[2];
+  const int end = min(slice[1], n_frame);
+  if (start < 0 || start >= end || stride < 1)
+    throw Key_list::Value_out_of_range_exception("FRAMES", 
+		 "start:end:stride with 0 <= start < end, start < " +
+		 String_util::int_to_string(n_frame) + " and stride >= 1");
+
+  // Skip frames already saved - default false
+  bool resume;
+  try { resume = params.get_bool("RESUME"); }
+  catch (Key_list::Key_not_found_exception) {
+    resume = false;
+  }
+  if (resume && video_file != "")
+    throw Key_list::Value_out_of_range_exception("RESUME", 
+						 "False with Y4M_File");
+  resume = resume && save;
+
+  // Keep the phases of the selected frames.  The movie lists every
+  // frame in the slice, including those already saved.
+  vector<float> all_phase = phase;
+  phase.clear();
+  frame_number.clear();
+  for (int i = start ; i < end ; i += stride) {
+    if (!(resume && frame_saved(i))) {
+      phase.push_back(all_phase[i]);
+      frame_number.push_back(i);
+    }
+    if (save && video_file == "") 
+      animator->add_image_to_mpeg(frame_filename(i));
+  }
+  n_phase = phase.size();
+
+  int n_selected = (end - start + stride - 1) / stride;
+  if (n_phase < n_selected)
+    cout << "   Skipping " << n_selected - n_phase 
+	 << " frames already saved\n";
+
+  // With every frame already saved the movie can be made straight away
+  if (n_phase == 0) {
+    cout << "   All frames already saved\n";
+    animator->make_mpeg();
+    save = false;
+  }
+}
+
+/*
+  Read the list of inclinations a still image is to be seen from.
+  Only the colours of the binary are recalculated for each view.
+*/
+void Bin_sim::select_views(Key_list &params)
+{
+  // Inclinations - default none, each must be 0.0-90.0
+  inclinations.clear();
+  string views;
+  try { views = params.get_value("INCLINATIONS"); }
+  catch (Key_list::Key_not_found_exception) {
+    return;
+  }
+
+  vector<string> parts = String_util::split_string(views, ',', true);
+  for (unsigned i = 0 ; i < parts.size() ; i++) {
+    float view;
+    char tail;
+    if (sscanf(parts[i].c_str(), "%f%c", &view, &tail) != 1)
+      throw Key_list::File_format_exception("INCLINATIONS = " + views);
+    if (view < 0.0f || view > 90.0f)
+      throw Key_list::Value_out_of_range_exception("INCLINATIONS", 
+						   "a list of 0.0-90.0");
+    inclinations.push_back(view);
+  }
+
   if (anim)
-    cout << "Frame " << phase_index << "\n";
+    throw Key_list::Value_out_of_range_exception("INCLINATIONS", 
+						 "unset for animations");
+
+  // Save the views as panels of one contact sheet?  Default false
+  try { contact_sheet = params.get_bool("CONTACT_SHEET"); }
+  catch (Key_list::Key_not_found_exception) {
+    contact_sheet = false;
+    print_default_key_msg("CONTACT_SHEET", "False");
+  }
 
+  if (contact_sheet) {
+    // Panels are rendered whole
+    if (tile_size > 0)
+      throw Key_list::Value_out_of_range_exception("TILE_SIZE", 
+						   "0 with Contact_Sheet");
+
+    // Number of panels across the sheet - default the fewest making
+    // a square sheet, must be >= 1
+    int n_square = 1;
+    while (n_square * n_square < static_cast<int>(inclinations.size()))
+      n_square++;
+    try { sheet_columns = params.get_int("SHEET_COLUMNS"); }
+    catch (Key_list::Key_not_found_exception) {
+      sheet_columns = n_square;
+      print_default_key_msg("SHEET_COLUMNS", 
+			    String_util::int_to_string(n_square));
+    }
+    if (sheet_columns < 1) 
+      throw Key_list::Value_out_of_range_exception("SHEET_COLUMNS", ">= 1");
+  } else if (save) {
+    // Each view is saved to its own file, named from a template
+    string filename = imagefile;
+    if (!String_util::replace_field(filename, "INCLINATION", ""))
+      throw Key_list::Value_out_of_range_exception("IMAGE_FILE",
+		   "a template including {Inclination}");
+  }
+}
+
+/*
+  Check whether the image of an animation frame has been saved.  A
+  file cut short, e.g. because an earlier run was interrupted while
+  writing it, does not count.
+*/
+bool Bin_sim::frame_saved(const int frame)
+{
+  std::ifstream image((anim_root + frame_filename(frame)).c_str(), 
+		      std::ios::binary | std::ios::ate);
+  std::streamoff pixel_bytes = 3 * static_cast<std::streamoff>(width) * height;
+
+  return image && image.tellg() >= pixel_bytes;
+}
+
+/*
+  Name of the image file for an animation frame, without the directory
+*/
+string Bin_sim::frame_filename(const int frame)
+{
   using String_util::int_to_string;
 
-  // Ensure phase_index >= 0
-  if (phase_index < 0) phase_index = 0;
-  
-    int bits;
-  glGetIntegerv(GL_ACCUM_BLUE_BITS, & bits);
-  cout << bits << '\n';
-  
+  return "binsim_tmp."  + int_to_string(frame, true, 4) + ".ppm";
+}
+
+/*
+  Write any outstanding frames after the last frame of an animation,
+  make the movie and stop saving
+*/
+void Bin_sim::finish_animation()
+{
+  if (video_file != "") writer->close_video();
+  else {
+    writer->flush();
+    animator->make_mpeg();
+  }
+  save = false;
+}
+
+/*
+  Draw the part of the world within the given limits
+*/
+void Bin_sim::render(const float x_min, const float x_max, 
+		     const float y_min, const float y_max)
+{
+  // Draw once into the supersampled framebuffer and filter the result
+  if (supersampler && !draft) {
+    supersampler->begin();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+    glOrtho(x_min, x_max, y_min, y_max, -10.0f, 10.0f);
+    gl_commands();
+    supersampler->end();
+  }
   // Draw with antialiasing enabled
-  if (antialias) {
+  else if (antialias && !draft) {
     glClear(GL_ACCUM_BUFFER_BIT);
 
+    // Record the scene once.  Each jittered pass only changes the
+    // projection, so replays the same commands without traversing the
+    // components again.
+    glNewList(scene_list, GL_COMPILE);
+    gl_commands();
+    glEndList();
+
     // Define jittering stepsize for antialiasing
     float dx = world_pixsize * 0.25;
     float dy = world_pixsize * 0.25;
@@ -379,10 +1005,10 @@ void Bin_sim::draw(const bool onscreen)
       for (int i = 0 ; i < 16 ; i++) {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
 	glLoadIdentity();
-	glOrtho(world_min_x + x_shift[i], world_max_x + x_shift[i], 
-	        world_min_y + y_shift[i], world_max_y + y_shift[i], 
+	glOrtho(x_min + x_shift[i], x_max + x_shift[i], 
+		y_min + y_shift[i], y_max + y_shift[i], 
 		-10.0f, 10.0f);
-	gl_commands();
+	glCallList(scene_list);
 	glAccum(GL_ACCUM, weight[i]/ weight_total);
       }
     }
@@ -400,10 +1026,10 @@ void Bin_sim::draw(const bool onscreen)
       for (int i = 0 ; i < 4 ; i++) {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
 	glLoadIdentity();
-	glOrtho(world_min_x + x_shift[i], world_max_x + x_shift[i], 
-		world_min_y + y_shift[i], world_max_y + y_shift[i], 
+	glOrtho(x_min + x_shift[i], x_max + x_shift[i], 
+		y_min + y_shift[i], y_max + y_shift[i], 
 		-10.0f, 10.0f);
-	gl_commands();
+	glCallList(scene_list);
 	glAccum(GL_ACCUM, weight[i]/ weight_total);
       }
     }
@@ -415,41 +1041,147 @@ void Bin_sim::draw(const bool onscreen)
   else {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
-    glOrtho(world_min_x, world_max_x, world_min_y, world_max_y, -10.0f, 10.0f);
+    glOrtho(x_min, x_max, y_min, y_max, -10.0f, 10.0f);
     gl_commands();
   }
-  
-  // Transfer current image to front buffer
-  if (onscreen) glutSwapBuffers();
+}
 
-  // Save current frame if desired.  Only save once on first draw.
-  if (save) {
-    if (anim) {
-      // Construct image filenames
-      string stripped_filename = "binsim_tmp."  + 
-        int_to_string(phase_index, true, 4) + ".ppm";
-      imagefile = anim_root + stripped_filename;
-      // Write animation frame
-      writer->write_ppm(imagefile);
-      //writer->write_jpeg(imagefile, jpeg_quality);
-      animator->add_image_to_mpeg(stripped_filename);
+/*
+  Save the current frame in the given format
+*/
+void Bin_sim::save_image(const string filename, const int format)
+{
+  if (tile_size > 0) {
+    draw_tiles(filename, format);
+    return;
+  }
 
-      // When last frame is written make movie and stop saving
-      if (last_frame()) {
-	animator->make_mpeg();
-	save = false;
-      }
-    } else {
-      // Write still image
-      if (output_format == Image_writer::PPM) {
-	writer->write_ppm(imagefile);
+  if (format == Image_writer::PPM) {
+    writer->write_ppm(filename);
 #ifndef NOJPEG
-      } else if (output_format == Image_writer::JPEG) {
-	writer->write_jpeg(imagefile, jpeg_quality);
+  } else if (format == Image_writer::JPEG) {
+    writer->write_jpeg(filename, jpeg_quality);
 #endif
-      }
-      save = false;
+  }
+}
+
+/*
+  Render and save a still image from each inclination in turn,
+  either to a file of its own or as a panel of a contact sheet
+*/
+void Bin_sim::save_views()
+{
+  // Inclination to return to once the views are saved
+  const float inclination = binary->inclination;
+
+  if (contact_sheet) {
+    draw_sheet(imagefile, output_format);
+    binary->set_inclination(inclination);
+    return;
+  }
+
+  for (unsigned i = 0 ; i < inclinations.size() ; i++) {
+    binary->set_inclination(inclinations[i]);
+    if (tile_size == 0)
+      render(world_min_x, world_max_x, world_min_y, world_max_y);
+
+    char view[32];
+    sprintf(view, "%g", inclinations[i]);
+    string filename = imagefile;
+    String_util::replace_field(filename, "INCLINATION", view);
+
+    cout << "View from inclination " << view << ": " << filename << "\n";
+    save_image(filename, output_format);
+  }
+
+  binary->set_inclination(inclination);
+}
+
+/*
+  Render the views in turn and save them as the panels of one image,
+  in rows from the top left.  Each row of panels is written as soon
+  as it is complete, and panels missing from the last row are black.
+*/
+void Bin_sim::draw_sheet(const string filename, const int format)
+{
+  const int n_view = inclinations.size();
+  const int n_row = (n_view + sheet_columns - 1) / sheet_columns;
+  const int sheet_width = sheet_columns * width;
+
+  Scanline_writer output(filename, sheet_width, n_row * height, format, 
+			 jpeg_quality);
+
+  GLubyte *panel = new GLubyte[width * height * 3];
+  GLubyte *band = new GLubyte[sheet_width * height * 3];
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  for (int row = 0 ; row < n_row ; row++) {
+    memset(band, 0, sheet_width * height * 3);
+
+    for (int col = 0 ; col < sheet_columns ; col++) {
+      const int view = row * sheet_columns + col;
+      if (view >= n_view) break;
+
+      cout << "View from inclination " << inclinations[view] << "\n";
+      binary->set_inclination(inclinations[view]);
+      render(world_min_x, world_max_x, world_min_y, world_max_y);
+
+      glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, panel);
+
+      // Copy into place, turning the rows the right way up
+      for (int y = 0 ; y < height ; y++)
+	memcpy(band + (y * sheet_width + col * width) * 3, 
+	       panel + (height - y - 1) * width * 3, width * 3);
     }
+
+    output.write_rows(band, height);
   }
+
+  delete[] panel;
+  delete[] band;
 }
 
+/*
+  Render the image in square tiles, working across each row of tiles
+  from the top, and write each row of tiles as soon as it is complete.
+  Tiles at the right and bottom edges are rendered full size and
+  cropped.
+*/
+void Bin_sim::draw_tiles(const string filename, const int format)
+{
+  Scanline_writer output(filename, width, height, format, jpeg_quality);
+
+  GLubyte *tile = new GLubyte[tile_size * tile_size * 3];
+  GLubyte *band = new GLubyte[width * tile_size * 3];
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  const float tile_world_size = tile_size * world_pixsize;
+
+  for (int tile_y = 0 ; tile_y < height ; tile_y += tile_size) {
+    const int tile_height = min(tile_size, height - tile_y);
+
+    for (int tile_x = 0 ; tile_x < width ; tile_x += tile_size) {
+      const int tile_width = min(tile_size, width - tile_x);
+
+      // Render the world under this tile
+      float x_min = world_min_x + tile_x * world_pixsize;
+      float y_max = world_max_y - tile_y * world_pixsize;
+      render(x_min, x_min + tile_world_size, y_max - tile_world_size, y_max);
+
+      glReadPixels(0, 0, tile_size, tile_size, GL_RGB, GL_UNSIGNED_BYTE, 
+		   tile);
+
+      // Copy into place, turning the rows the right way up
+      for (int row = 0 ; row < tile_height ; row++)
+	memcpy(band + (row * width + tile_x) * 3, 
+	       tile + (tile_size - row - 1) * tile_size * 3, tile_width * 3);
+    }
+
+    output.write_rows(band, tile_height);
+  }
+
+  delete[] tile;
+  delete[] band;
+}
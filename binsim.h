@@ -34,6 +34,7 @@
 #include "keyword.h"
 #include "movie_maker.h"
 #include "starsky.h"
+#include "supersampler.h"
 
 #include "binsim_stdinc.h"
 
@@ -58,12 +59,72 @@ class Bin_sim {
   // Binary object
   Binary_3d *binary;
 
+  // Display list holding the scene while it is drawn repeatedly for
+  // antialiasing
+  GLuint scene_list;
+
+  // Supersampled framebuffer, if used for antialiasing
+  Supersampler *supersampler;
+
+  // Whether the binary and other components belong to this object,
+  // rather than being shared with the model this is a view of
+  bool owns_model;
+
+  // Draw without antialiasing while the view is being changed
+  bool draft;
+
+  // Derive the part of the world shown from the scale and centre
+  void set_world_window();
+
   // Draw objects
   void gl_commands(void);
+
+  // Draw the part of the world within the given limits, filling the
+  // OpenGL buffer
+  void render(const float x_min, const float x_max, const float y_min,
+	      const float y_max);
+
+  // Save the current frame, rendering it in tiles if necessary
+  void save_image(const string filename, const int format);
+
+  // Render and save the image one row of tiles at a time
+  void draw_tiles(const string filename, const int format);
+
+  // Render and save the view from each inclination of a still image
+  void save_views();
+
+  // Render the views into panels of one image, saved one row of
+  // panels at a time
+  void draw_sheet(const string filename, const int format);
+
+  // Restrict an animation to the frames selected in the parameter
+  // list
+  void select_frames(Key_list &params);
+
+  // Check whether the image of an animation frame has been saved
+  bool frame_saved(const int frame);
+
+  // Name of the image file for an animation frame
+  string frame_filename(const int frame);
+
+  // Complete a saved animation after its last frame
+  void finish_animation();
+
+  // Read the inclinations a still image is seen from
+  void select_views(Key_list &params);
+
+  // Identify the format of an image file from its extension
+  static int image_format(const string filename);
 public:
   // Image quality options
   bool high_quality, hq_antialias, antialias;
   int width, height, n_samples;
+  bool supersample;
+  int aa_factor, aa_filter;
+
+  // Size of tiles when rendering in tiles, or 0, and the size of the
+  // OpenGL buffer needed
+  int tile_size, render_width, render_height;
 
   // View options
   float scale, aspect_ratio;
@@ -72,14 +133,27 @@ public:
   float world_min_x, world_max_x, world_min_y, world_max_y;
   vector <float> phase;
 
+  // Frame number of each phase of an animation, counting every phase
+  // from LOW_PHASE whether or not it is drawn
+  vector <int> frame_number;
+
+  // Inclinations a still image is seen from, if more than the one
+  // the binary was created with, and whether they are saved as the
+  // panels of one contact sheet
+  vector <float> inclinations;
+  bool contact_sheet;
+  int sheet_columns;
+
   // Animation options
   bool anim;
 
+  // Can the phase and view be changed by hand?
+  bool interactive;
+
   // Output options
   bool save;
   int jpeg_quality;
-  string imagefile, anim_root;
-  bool vertex_log;
+  string imagefile, anim_root, video_file;
   int output_format;
 
   // Starfield options
@@ -87,8 +161,25 @@ public:
   int n_star;
   float star_colour_range, star_size;
 
-  // Constructor
-  Bin_sim(Key_list &params, Image_writer *writer1);
+  // Constructor, optionally sharing a cache of stream trajectories
+  Bin_sim(Key_list &params, Image_writer *writer1, 
+	  Stream_cache *streams = 0);
+
+  // Constructor for a view of the same model drawn into another
+  // OpenGL context
+  Bin_sim(const Bin_sim &model, Image_writer *writer1);
+
+  ~Bin_sim();
+
+  // Draw the same model with new parameters, returning false if they
+  // change more than the view and the model must be rebuilt
+  bool update_view(Key_list &params, const vector<string> &changed);
+
+  // Check whether a parameter file streams video to standard output
+  static bool video_to_stdout(const string param_file);
+
+  // Create the vertex log shared by all models, if it is wanted
+  static void start_vertex_log(Key_list &params);
 
   // Draw image
   void draw(const bool onscreen);
@@ -96,11 +187,34 @@ public:
   // Initialisation of OpenGL
   void gl_setup(const bool onscreen);
 
+  // Initialisation of the current OpenGL context, for views
+  void gl_setup_context();
+
+  // Prepare to draw frames in several views at once, returning false
+  // if not possible
+  bool prepare_concurrent_drawing();
+
+  // Draw a phase without displaying or saving it
+  void draw_phase(const int phase);
+
+  // Save an animation frame drawn by a view, in order of phase
+  void save_frame(unsigned char *pixels, const int phase);
+
   // Check for last frame
   bool last_frame() { return (phase_index == n_phase - 1); }
 
   // Go to the next frame
   void next_frame() { if (phase_index < n_phase-1) phase_index++; }
+
+  // Change the phase, inclination, scale and centre of the image by
+  // hand.  Distances are in pixels.
+  void move_phase(const float d_phase);
+  void move_inclination(const float d_inclination);
+  void zoom(const float factor);
+  void pan(const int dx, const int dy);
+
+  // Draw quickly, without antialiasing, while the view is changing
+  void set_draft(const bool draft1) { draft = draft1; }
 };
 
 /*****************************************************************************/
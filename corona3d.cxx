@@ -39,8 +39,9 @@
 Corona_3d::Corona_3d(const int n_steps1,
 		     const vector<float> phase, const float q, 
 		     const float inclination, const float radius,     
-		     const float red, const float green, const float blue,
-		     const float opacity, const float gradient,
+		     const float red1, const float green1, 
+		     const float blue1, const float opacity1, 
+		     const float gradient1,
 		     const bool companion) 
   : Transparent_object_3d(phase, 4*n_steps1, 2*n_steps1+1, inclination)
 {
@@ -58,6 +59,13 @@ Corona_3d::Corona_3d(const int n_steps1,
   Roche_lobe lobe(1.0/q);
   const float c_of_m = lobe.get_c_of_m();
 
+  // Save the properties needed to calculate colours
+  red = red1;
+  green = green1;
+  blue = blue1;
+  opacity = opacity1;
+  gradient = gradient1;
+
   for (int i = 0 ; i < n_theta ; i++) {
     // Calculate angle of longitude
     float theta = PI * i / (n_theta-1.0f);
@@ -72,20 +80,6 @@ Corona_3d::Corona_3d(const int n_steps1,
       // Determine index offset for this point
       int index = i*n_phi + j;
 
-      for (int k = 0 ; k < n_phase ; k++) {
-	// Calculate transparency
-	float alpha = pow(eye_vec[k] * r_vect, gradient) * opacity; 
-
-	// Determine phase dependent index for storing colour
-	int index1 = k*n_vert + index;
-
-	// Assign colours
-	red_grid[index1] = red;      
-	green_grid[index1] = green;      
-	blue_grid[index1] = blue;
-	alpha_grid[index1] = alpha * 0.5f;
-      }
-
       // Assign coordinates; corona may be around companion or accretor
       if (companion) 
 	*(coord_grid[index])   = radius * r_vect.x - (1.0f - c_of_m);
@@ -97,3 +91,37 @@ Corona_3d::Corona_3d(const int n_steps1,
   }
 }
 
+/*
+  Calculate colours and opacities of the corona at one phase
+*/
+void Corona_3d::calc_colours(const int phase_index, const int offset)
+{
+  using Sci_const::PI;
+
+  const int k = phase_index;
+
+  for (int i = 0 ; i < n_theta ; i++) {
+    // Calculate angle of longitude
+    float theta = PI * i / (n_theta-1.0f);
+
+    for (int j = 0 ; j < n_phi ; j++) {
+      // Calculate angle of latitude
+      float phi = (2.0f * PI * j) / n_phi;
+
+      // Radial vector passing through point
+      Vec3 r_vect(sin(theta)*cos(phi), sin(theta)*sin(phi), cos(theta));
+
+      // Calculate transparency
+      float alpha = pow(eye_vec[k] * r_vect, gradient) * opacity; 
+
+      // Determine phase dependent index for storing colour
+      int index1 = offset + i*n_phi + j;
+
+      // Assign colours
+      red_grid[index1] = red;      
+      green_grid[index1] = green;      
+      blue_grid[index1] = blue;
+      alpha_grid[index1] = alpha * 0.5f;
+    }
+  }
+}
@@ -38,13 +38,19 @@
 class Corona_3d : public Transparent_object_3d {
   // Define the surface grid
   int n_steps, n_theta, n_phi;
+
+  // Colour, opacity and radial density gradient
+  float red, green, blue, opacity, gradient;
+
+  // Calculate colours at one phase
+  void calc_colours(const int phase_index, const int offset);
 public:
   // Constructor
   Corona_3d(const int nsteps1, 
 	    const vector<float> phase, const float q, 
 	    const float inclination, const float radius, 
-	    const float red, const float green, const float blue,
-	    const float opacity, const float gradient,
+	    const float red1, const float green1, const float blue1,
+	    const float opacity1, const float gradient1,
 	    const bool companion = false);
 };
 
@@ -43,8 +43,10 @@ Disc_3d::Disc_3d(const int n_steps1, const vector<float> phase, const float q,
 		 const float r_disc, const float r_in, 
 		 const float tout, const float temp_grad, 
 		 const float beta, 
-		 const float hot_temp, const int n_flare,
-		 const int flare_length, BB_color_model &cm) 
+		 const float hot_temp1, const int n_flare,
+		 const int flare_length, BB_color_model &cm1,
+		 Stream_cache &streams, Thread_pool &pool1,
+		 const Random_stream &random) 
   : Object_3d(phase, n_steps1*4, n_steps1*2, inclination)
 {
   using namespace Sci_const;
@@ -63,38 +65,31 @@ Disc_3d::Disc_3d(const int n_steps1, const vector<float> phase, const float q,
   // Create disc model
   Disc disc(1.0/q, period, mass, disc_thick, r_disc, tout, temp_grad, beta);
   
-  // Create stream model
-  Stream stream_model(q, mass, period);
+  // Get stream model
+  Stream &stream_model = streams.get_stream(q, mass, period);
   vector<Vec3> stream = stream_model.stream_calc(0.005, r_disc);
 
   // Determine location of hotspot
   Vec3 hotspot_centre = stream[stream.size()-1];
   hotspot_centre.x = lobe.get_c_of_m() - hotspot_centre.x;
 
-  // Coordinates on disc surface
-  float r, phi;
-
-  // Properties of point on the surface
-  Surface_properties surf;
-  float temp, tirr;
-  Vec3 rgb;
-  
-  // Index variables
-  int i, index;
-
   // Positions of flares on the disc
-  float *flares = new float[n_rad*n_phi];
+  flares = new float[n_rad*n_phi];
+
+  // Temperatures for the shader are only needed if one is used
+  shade_temp = 0;
 
   // Initialise flare distribution
-  for (i = 0 ; i < n_rad ; i++)
+  for (int i = 0 ; i < n_rad ; i++)
     for (int j = 0 ; j < n_phi ; j++)
       flares[i*n_phi + j] = 1.0f;
 
   // Add flares
-  for (i = 0 ; i < n_flare ; i++) {
+  for (int i = 0 ; i < n_flare ; i++) {
     // Determine random location of flare
-    int index_r = (int) (((float) rand()) / RAND_MAX * (n_rad-1));
-    int index_phi = (int) (((float) rand()) / RAND_MAX * (n_phi-1));
+    Random_stream flare_random = random.substream(i);
+    int index_r = (int) (flare_random.uniform() * (n_rad-1));
+    int index_phi = (int) (flare_random.uniform() * (n_phi-1));
 
     // Smear flare in azimuth
     if (abs(index_r-n_rad/2) > 3) {
@@ -108,97 +103,201 @@ Disc_3d::Disc_3d(const int n_steps1, const vector<float> phase, const float q,
   }
 
   // Parameters for extension of hotspot on disc
-  float rDiff, phiDiff, phi0 = PI + atan(-hotspot_centre.y / hotspot_centre.x);
-  float fPhi, fR;
-
-  for (i = 0 ; i < n_rad ; i++) {
-    // Calculate radius
-    if (i < n_rad/2)
-      r =  ((r_disc - r_in) * i / (n_rad/2-1.0f) + r_in) * 
-	lobe.get_eggleton();
-    else
-      r = ((r_disc - r_in) * (n_rad-1-i) / (n_rad/2-1.0f) + r_in) * 
-	lobe.get_eggleton();
-
-    // Calculate Keplerian period as fraction of Porb
-    float p_kep = sqrt(r*r*r*(1.0f + q));
-
-    for (int j = 0 ; j < n_phi ; j++) {
-      // Calculate azimuthal angle
-      phi = (2.0f * PI * j) / n_phi;
-
-      // Determine index offset for this point
-      index = i * n_phi + j;
-
-      // Get properties of the point on the surface
-      surf = disc.get_surface_properties(r, phi);
-      tirr = surf.t_irr;
-      if (i >= n_rad/2) surf.normal.z = -surf.normal.z;
-
-      // Code to add hot spot 
-      phiDiff = phi - phi0;
-      rDiff = fabs(r - r_disc * lobe.get_eggleton());
-      if (phiDiff > 0.0f)
-	fPhi = exp(-1.0f * phiDiff * phiDiff);
-      else 
-	fPhi = exp(-50.0f * phiDiff * phiDiff);
-      fR = exp(-500.0f * rDiff * rDiff);
-
-      for (int k = 0 ; k < n_phase ; k++) {
-	// Determine index for flares allowing for Keplerian rotation
-	int j1;
-	if (i != 0 && i != n_rad-1)
-	  j1 = j - static_cast<int> 
-	    (phase[k] / p_kep * n_phi + 0.5f);
-	else j1 = j;
-	while (j1 < 0) j1 += n_phi;
+  float phi0 = PI + atan(-hotspot_centre.y / hotspot_centre.x);
+
+  hot_phi = new float[n_phi];
+  for (int j = 0 ; j < n_phi ; j++) {
+    float phi = (2.0f * PI * j) / n_phi;
+    float phiDiff = phi - phi0;
+    if (phiDiff > 0.0f)
+      hot_phi[j] = exp(-1.0f * phiDiff * phiDiff);
+    else 
+      hot_phi[j] = exp(-50.0f * phiDiff * phiDiff);
+  }
 
-	// Get temperature of this point
-	temp = surf.temp;
+  // Save the phase independent properties needed to calculate colours
+  hot_temp = hot_temp1;
+  cm = &cm1;
+  pool = &pool1;
+
+  p_kep = new float[n_rad];
+  hot_r = new float[n_rad];
+  temp_grid = new float[n_vert];
+  normal_grid = new Vec3[n_vert];
+
+  // Lobe properties used by every ring.  They are read here because
+  // the lobe caches them on first use, which is not safe from several
+  // threads at once.
+  const float r_egg = lobe.get_eggleton();
+  const float c_of_m = lobe.get_c_of_m();
+
+  // Each ring of the disc is independent, so they are shared between
+  // threads
+  pool1.parallel_for(0, n_rad, [&](int i) {
+      // Calculate radius
+      float r;
+      if (i < n_rad/2)
+	r =  ((r_disc - r_in) * i / (n_rad/2-1.0f) + r_in) * 
+	  r_egg;
+      else
+	r = ((r_disc - r_in) * (n_rad-1-i) / (n_rad/2-1.0f) + r_in) * 
+	  r_egg;
+
+      // Calculate Keplerian period as fraction of Porb
+      p_kep[i] = sqrt(r*r*r*(1.0f + q));
+
+      // Radial extent of heating downstream of hot spot
+      float rDiff = fabs(r - r_disc * r_egg);
+      hot_r[i] = exp(-500.0f * rDiff * rDiff);
+
+      for (int j = 0 ; j < n_phi ; j++) {
+	// Calculate azimuthal angle
+	float phi = (2.0f * PI * j) / n_phi;
+
+	// Determine index offset for this point
+	int index = i * n_phi + j;
+
+	// Get properties of the point on the surface
+	Surface_properties surf = disc.get_surface_properties(r, phi);
+	if (i >= n_rad/2) surf.normal.z = -surf.normal.z;
+
+	temp_grid[index] = surf.temp;
+	normal_grid[index] = surf.normal;
+
+	if (r_in > 0.0f && (i == 0 || i == n_rad-1))
+	  surf.coords.z = 0.0f;
+	if (i > n_rad/2) surf.coords.z = -surf.coords.z;
+      
+	// Assign coordinates
+	*(coord_grid[index])   = surf.coords.x + c_of_m;
+	*(coord_grid[index]+1) = surf.coords.y;
+	*(coord_grid[index]+2) = surf.coords.z;
+      }
+    });
+}
+
+/*
+  Release dynamically allocated memory
+*/
+Disc_3d::~Disc_3d()
+{
+  delete[] temp_grid;
+  delete[] normal_grid;
+  delete[] p_kep;
+  delete[] hot_r;
+  delete[] hot_phi;
+  delete[] flares;
+  delete[] shade_temp;
+}
+
+/*
+  Return the temperature of a point at one phase, including flares
+  and heating by the hot spot
+*/
+float Disc_3d::get_temp(const int phase_index, const int i, const int j)
+{
+  // Determine index for flares allowing for Keplerian rotation
+  int j1;
+  if (i != 0 && i != n_rad-1)
+    j1 = j - static_cast<int> (phase[phase_index] / p_kep[i] * n_phi + 0.5f);
+  else j1 = j;
+  while (j1 < 0) j1 += n_phi;
+
+  // Get temperature of this point
+  float temp = temp_grid[i*n_phi + j];
+
+  // Apply flares to disc
+  temp *= flares[i*n_phi + j1];
+
+  // Apply heating downstream of hotspot
+  temp += hot_temp * hot_r[i] * hot_phi[j];
+
+  return temp;
+}
+
+/*
+  Calculate colours of the disc surface at one phase.  Each ring of
+  the disc is independent, so they are shared between threads.
+*/
+void Disc_3d::calc_colours(const int phase_index, const int offset)
+{
+  const int k = phase_index;
 
-	// Apply flares to disc
-	temp *= flares[i*n_phi + j1];
+  pool->parallel_for(0, n_rad, [&](int i) {
+      // Temperatures and viewing angles around the ring
+      vector<float> row_temp(n_phi), row_mu(n_phi);
 
-	// Apply heating downstream of hotspot
-	temp += hot_temp * fR * fPhi;
+      for (int j = 0 ; j < n_phi ; j++) {
+	// Determine index offset for this point
+	int index = i * n_phi + j;
 
-	// Determine phase dependent index for storing colour
-	int index1 = k * n_vert + index;
+	// Get temperature of this point
+	row_temp[j] = get_temp(k, i, j);
+	row_mu[j] = fabs(normal_grid[index] * eye_vec[k]);
+      }
 
-	// Calculate limb darkened colour on surface
-	float mu = fabs(surf.normal * eye_vec[k]);
- 	rgb = cm.get_rgb(temp, mu);
+      // Determine phase dependent index for storing colours
+      int index1 = offset + i * n_phi;
 
-	// Assign colours
+      // Assign limb darkened colours for the whole ring
 #ifdef WIREFRAME
-	red_grid[index1] = 0.4f;
-	green_grid[index1] = 0.7f;
-	blue_grid[index1] = 1.0f;
+      for (int j = 0 ; j < n_phi ; j++) {
+	red_grid[index1 + j] = 0.4f;
+	green_grid[index1 + j] = 0.7f;
+	blue_grid[index1 + j] = 1.0f;
+      }
 #else
-	if (i == n_rad/2) {
-	  int index2 = index1 - n_phi;
-	  red_grid[index1] = red_grid[index2];
-	  green_grid[index1] = green_grid[index2];
-	  blue_grid[index1] = blue_grid[index2];
-	} else {
-	  red_grid[index1] = rgb.x;
-	  green_grid[index1] = rgb.y;
-	  blue_grid[index1] = rgb.z;
-	}
+      cm->get_rgb(n_phi, &row_temp[0], &row_mu[0], red_grid + index1, 
+		  green_grid + index1, blue_grid + index1);
 #endif
-      }
-      if (r_in > 0.0f && (i == 0 || i == n_rad-1))
-	surf.coords.z = 0.0f;
-      if (i > n_rad/2) surf.coords.z = -surf.coords.z;
-      
-      // Assign coordinates
-      *(coord_grid[index])   = surf.coords.x + lobe.get_c_of_m();
-      *(coord_grid[index]+1) = surf.coords.y;
-      *(coord_grid[index]+2) = surf.coords.z;
-    }
+    });
+
+#ifndef WIREFRAME
+  // The outer edge of the lower surface takes its colours from the
+  // outer edge of the upper surface
+  for (int j = 0 ; j < n_phi ; j++) {
+    int index1 = offset + (n_rad/2) * n_phi + j;
+    int index2 = index1 - n_phi;
+    red_grid[index1] = red_grid[index2];
+    green_grid[index1] = green_grid[index2];
+    blue_grid[index1] = blue_grid[index2];
   }
+#endif
+}
 
-  // Clean up
-  delete[] flares;
+/*
+  Calculate the temperature of every point at one phase for the shader
+*/
+void Disc_3d::prepare_shading(const int phase_index)
+{
+  if (shade_temp == 0) shade_temp = new float[n_vert];
+
+  pool->parallel_for(0, n_rad, [&](int i) {
+      for (int j = 0 ; j < n_phi ; j++)
+	shade_temp[i*n_phi + j] = get_temp(phase_index, i, j);
+    });
+}
+
+/*
+  Set the observer direction in the shader.  The disc has no
+  granulation.
+*/
+void Disc_3d::begin_shading(const int phase_index)
+{
+  shader->set_eye(eye_vec[phase_index]);
+  shader->set_granulation(phase[phase_index], 0.0f, 1.0f);
 }
 
+/*
+  Supply the temperature and normal of a point to the shader
+*/
+void Disc_3d::shade_vertex(const int coord_index)
+{
+  int index = coord_index;
+
+  // The outer edge of the lower surface is shaded as the outer edge
+  // of the upper surface, as in calc_colours
+  if (index / n_phi == n_rad/2) index -= n_phi;
+
+  BB_shader::set_vertex(normal_grid[index], shade_temp[index]);
+}
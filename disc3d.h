@@ -31,6 +31,9 @@
 
 #include "bbcolormodel.h"
 #include "object3d.h"
+#include "random_stream.h"
+#include "stream.h"
+#include "thread_pool.h"
 
 #include "binsim_stdinc.h"
 
@@ -40,6 +43,36 @@ class Disc_3d : public Object_3d {
   // Define the surface grid
   int n_steps, n_rad, n_phi;
 
+  // Phase independent properties of each point on the surface
+  float *temp_grid;
+  Vec3 *normal_grid;
+
+  // Keplerian period and hot spot heating profile of each ring, and
+  // hot spot heating profile in azimuth
+  float *p_kep, *hot_r, *hot_phi;
+  float hot_temp;
+
+  // Flare distribution on the disc
+  float *flares;
+
+  // Temperature of each point at the phase being drawn with a shader
+  float *shade_temp;
+
+  // Colour model and threads used to calculate colours
+  BB_color_model *cm;
+  Thread_pool *pool;
+
+  // Calculate colours at one phase
+  void calc_colours(const int phase_index, const int offset);
+
+  // Temperature of a point at one phase
+  float get_temp(const int phase_index, const int i, const int j);
+
+  // Calculate colours with the black body shader
+  bool supports_shader() { return true; }
+  void prepare_shading(const int phase_index);
+  void begin_shading(const int phase_index);
+  void shade_vertex(const int coord_index);
 public:
   // Constructor
   Disc_3d(const int n_steps1, const vector<float> phase, const float q, 
@@ -47,8 +80,12 @@ public:
 	  const float mass, const float disc_thick, 
 	  const float r_disc, const float r_in, 
 	  const float tout, const float temp_grad,
-	  const float beta, const float hot_temp, 
-	  const int n_flare, const int flare_length, BB_color_model &cm);
+	  const float beta, const float hot_temp1, 
+	  const int n_flare, const int flare_length, BB_color_model &cm1,
+	  Stream_cache &streams, Thread_pool &pool1,
+	  const Random_stream &random);
+
+  ~Disc_3d();
 };
 
 /*****************************************************************************/
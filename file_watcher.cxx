@@ -0,0 +1,124 @@
+/*
+  Class to notice when a file has been changed
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
+
+#include "file_watcher.h"
+
+/*****************************************************************************/
+
+/*
+  Constructor - start watching the file
+*/
+File_watcher::File_watcher(const string filename1)
+{
+  filename = filename1;
+
+  // Split the filename into its directory and name
+  string::size_type slash = filename.find_last_of("/\\");
+  if (slash == string::npos) {
+    directory = ".";
+    basename = filename;
+  } else {
+    directory = filename.substr(0, slash + 1);
+    basename = filename.substr(slash + 1);
+  }
+
+  mtime = get_mtime();
+
+  // Watch for the file being written or moved into place
+  inotify_fd = -1;
+#ifdef __linux__
+  inotify_fd = inotify_init1(IN_NONBLOCK);
+  if (inotify_fd >= 0 &&
+      inotify_add_watch(inotify_fd, directory.c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(inotify_fd);
+    inotify_fd = -1;
+  }
+#endif
+}
+
+/*
+  Stop watching the file
+*/
+File_watcher::~File_watcher()
+{
+#ifdef __linux__
+  if (inotify_fd >= 0) close(inotify_fd);
+#endif
+}
+
+/*
+  Check whether the file has been changed since the last check,
+  without waiting
+*/
+bool File_watcher::changed()
+{
+#ifdef __linux__
+  if (inotify_fd >= 0) {
+    // Read every waiting event, looking for any naming the file
+    union {
+      struct inotify_event event;
+      char bytes[4096];
+    } buffer;
+
+    bool found = false;
+    ssize_t n;
+    while ((n = read(inotify_fd, buffer.bytes, sizeof(buffer))) > 0) {
+      for (char *p = buffer.bytes ; p < buffer.bytes + n ; ) {
+	struct inotify_event *event =
+	  reinterpret_cast<struct inotify_event*> (p);
+	if (event->len > 0 && basename == event->name) found = true;
+	p += sizeof(struct inotify_event) + event->len;
+      }
+    }
+    return found;
+  }
+#endif
+
+  time_t new_mtime = get_mtime();
+  if (new_mtime == mtime) return false;
+
+  mtime = new_mtime;
+  return true;
+}
+
+/*
+  Read the modification time of the file
+*/
+time_t File_watcher::get_mtime()
+{
+  struct stat status;
+  if (stat(filename.c_str(), &status) != 0) return 0;
+  return status.st_mtime;
+}
+
+/*****************************************************************************/
@@ -0,0 +1,71 @@
+/*
+  Class to notice when a file has been changed
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _FILE_WATCHER_H
+#define _FILE_WATCHER_H
+
+#include <ctime>
+#include <string>
+
+#include "binsim_stdinc.h"
+
+using std::string;
+
+/*****************************************************************************/
+
+/*
+  On Linux the directory holding the file is watched with inotify, so
+  that files replaced by editors saving to a new file are noticed as
+  well as those written in place.  Elsewhere, or if inotify is not
+  available, the modification time of the file is compared instead.
+*/
+class File_watcher {
+  // File watched, and the directory holding it
+  string filename, directory, basename;
+
+  // Inotify instance, or -1 if not in use
+  int inotify_fd;
+
+  // Modification time when last checked
+  time_t mtime;
+
+  // Current modification time of the file, or 0 if it cannot be read
+  time_t get_mtime();
+
+  // Not copyable
+  File_watcher(const File_watcher&);
+  File_watcher& operator= (const File_watcher&);
+public:
+  // Constructor and destructor
+  File_watcher(const string filename1);
+  ~File_watcher();
+
+  // Has the file changed since the last check?  Never waits.
+  bool changed();
+};
+
+/*****************************************************************************/
+
+#endif
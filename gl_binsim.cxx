@@ -23,8 +23,11 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>. 
 */
 
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #ifdef __APPLE__
 	#include <GLUT/glut.h>
@@ -35,9 +38,11 @@
 #include "binsim.h"
 #include "binsim_version.h"
 #include "errmsg.h"
+#include "file_watcher.h"
 #include "image_writer.h"
 #include "keyword.h"
 #include "keyword_translator.h"
+#include "stream.h"
 
 #include "binsim_stdinc.h"
 
@@ -48,14 +53,126 @@ using std::cout;
 // Object encapsulating information about the model
 Bin_sim *bin_sim;
 
+// Parameter file, watched so that the model can be rebuilt when it is
+// edited, and the parameters the model was built from
+string filename;
+File_watcher *watcher;
+Key_list *model_params;
+
+// Model being rebuilt in the background from edited parameters, if
+// any.  The current model is drawn until it is ready.
+std::future<Bin_sim*> rebuild;
+Key_list *new_params = 0;
+
+// Image writer and stream trajectories, kept when the model is rebuilt
+FB_image_writer *writer;
+Stream_cache streams;
+
+// Whether the window has an accumulation buffer, which cannot be
+// added once it has been created
+bool window_accum;
+
+// Changes of phase and inclination made by hand since the last draw,
+// applied together when the next frame is drawn
+float d_phase = 0.0f, d_inclination = 0.0f;
+
+// Mouse button held down, if any, and the last position of the mouse
+int mouse_button = -1, mouse_x, mouse_y;
+
+// Count of changes made by hand, used to find when they stop
+int n_moves = 0;
+
 // OpenGL friendly wrapper for draw function of bin_sim
-void draw(void) { bin_sim->draw(true); }
+void draw(void)
+{
+  if (d_phase != 0.0f) bin_sim->move_phase(d_phase);
+  if (d_inclination != 0.0f) bin_sim->move_inclination(d_inclination);
+  d_phase = d_inclination = 0.0f;
+
+  bin_sim->draw(true);
+}
+
+// Draw in full quality once the view has stopped changing
+void settle(int move)
+{
+  if (move == n_moves) {
+    bin_sim->set_draft(false);
+    glutPostRedisplay();
+  }
+}
+
+// Draw quickly while the view is being changed by hand
+void moved()
+{
+  bin_sim->set_draft(true);
+  glutPostRedisplay();
+  glutTimerFunc(250, settle, ++n_moves);
+}
 
 // Handle keyboard events
 void key(unsigned char k, int x, int y)
 {
   // Exit normally
   if (k == 27) exit(0);
+
+  if (!bin_sim->interactive) return;
+
+  // Zoom in and out
+  if (k == '+' || k == '=') bin_sim->zoom(1.25f);
+  else if (k == '-') bin_sim->zoom(0.8f);
+  else return;
+
+  moved();
+}
+
+// Handle arrow keys, changing phase and inclination in small steps
+void special_key(int k, int x, int y)
+{
+  if (!bin_sim->interactive) return;
+
+  if (k == GLUT_KEY_LEFT) d_phase -= 0.01f;
+  else if (k == GLUT_KEY_RIGHT) d_phase += 0.01f;
+  else if (k == GLUT_KEY_UP) d_inclination += 1.0f;
+  else if (k == GLUT_KEY_DOWN) d_inclination -= 1.0f;
+  else return;
+
+  moved();
+}
+
+// Handle mouse buttons.  The wheel is reported as buttons 3 and 4.
+void mouse(int button, int state, int x, int y)
+{
+  if (!bin_sim->interactive) return;
+
+  if (state == GLUT_DOWN && (button == 3 || button == 4)) {
+    bin_sim->zoom(button == 3 ? 1.1f : 1.0f / 1.1f);
+    moved();
+    return;
+  }
+
+  mouse_button = (state == GLUT_DOWN) ? button : -1;
+  mouse_x = x;
+  mouse_y = y;
+}
+
+// Handle dragging.  Dragging across the whole window with the left
+// button advances the phase by one orbit, and dragging up and down
+// tilts the binary.  Other buttons move the image.
+void motion(int x, int y)
+{
+  if (!bin_sim->interactive) return;
+
+  const int dx = x - mouse_x, dy = y - mouse_y;
+  mouse_x = x;
+  mouse_y = y;
+
+  if (mouse_button == GLUT_LEFT_BUTTON) {
+    d_phase += static_cast<float> (dx) / glutGet(GLUT_WINDOW_WIDTH);
+    d_inclination -= 90.0f * dy / glutGet(GLUT_WINDOW_HEIGHT);
+  } else if (mouse_button >= 0) bin_sim->pan(dx, dy);
+  else return;
+
+  moved();
 }
 
 // OpenGL friendly wrapper for next frame function of bin_sim
@@ -74,6 +191,107 @@ void terminate(string msg)
   exit(1);
 }
 
+// Print an error in an edited parameter file and keep the current model
+void reload_failed(string msg)
+{
+  cout << msg << "\n\nKeeping current model\n";
+  delete new_params;
+  new_params = 0;
+}
+
+// Replace the model with one rebuilt from edited parameters.  This
+// needs the OpenGL context, so is done here rather than by the thread
+// building the model.
+void swap_model()
+{
+  Bin_sim *new_sim = rebuild.get();
+
+  // Accumulation antialiasing needs a buffer the window was not
+  // created with
+  if (new_sim->antialias && !new_sim->supersample && !window_accum) {
+    delete new_sim;
+    throw Key_list::Value_out_of_range_exception("AA_METHOD", 
+	      "SUPERSAMPLE unless binsim is restarted with accumulation "
+	      "antialiasing");
+  }
+
+  delete bin_sim;
+  delete model_params;
+  bin_sim = new_sim;
+  model_params = new_params;
+  new_params = 0;
+
+  bin_sim->gl_setup_context();
+  glutPostRedisplay();
+  cout << "Model rebuilt\n";
+}
+
+// Read an edited parameter file.  Changes to the view alone are made
+// straight away, while other changes rebuild the model in the
+// background.
+void reload_params()
+{
+  cout << "Parameter file changed - parsing...\n";
+  new_params = new Key_list(filename);
+  apply_keyword_translation(new_params);
+
+  vector<string> changed = new_params->changed_keys(*model_params);
+  if (changed.empty()) {
+    delete new_params;
+    new_params = 0;
+    return;
+  }
+
+  // The window and image writer are kept, so their size is fixed
+  for (unsigned i = 0 ; i < changed.size() ; i++)
+    if (changed[i] == "WIDTH" || changed[i] == "HEIGHT" || 
+	changed[i] == "TILE_SIZE" || changed[i] == "ANIM" ||
+	changed[i] == "VERTEX_LOG")
+      throw Key_list::Value_out_of_range_exception(changed[i], 
+			   "unchanged while running - restart binsim");
+
+  if (bin_sim->update_view(*new_params, changed)) {
+    delete model_params;
+    model_params = new_params;
+    new_params = 0;
+    glutPostRedisplay();
+    return;
+  }
+
+  cout << "Rebuilding model...\n";
+  Key_list *params = new_params;
+  rebuild = std::async(std::launch::async, [params]() { 
+      return new Bin_sim(*params, writer, &streams); 
+    });
+}
+
+// Check regularly for an edited parameter file or a rebuilt model
+void check_params(int value)
+{
+  glutTimerFunc(500, check_params, 0);
+
+  try {
+    if (rebuild.valid()) {
+      if (rebuild.wait_for(std::chrono::seconds(0)) == 
+	  std::future_status::ready) 
+	swap_model();
+    } else if (watcher->changed()) reload_params();
+  }
+  catch (Key_list::File_access_exception e) {
+    reload_failed("File access error: " + e);
+  } 
+  catch (Key_list::File_format_exception e) {
+    reload_failed("File format error: " + e);
+  } 
+  catch (Key_list::Key_not_found_exception e) {
+    reload_failed("   Key not found: " + e + " - No default value!");
+  } 
+  catch (Key_list::Value_out_of_range_exception e) {
+    reload_failed("   Value out of range: " + e.keyword + 
+		  " - Must be " + e.value);
+  }
+}
+
 // Print an Keyword default message and continue
 void print_default_key_msg(const string key, const string def)
 {
@@ -84,9 +302,6 @@ void print_default_key_msg(const string key, const string def)
 
 int main(int argc, char** argv)
 {
-  // Parameter file
-  string filename;
-
   // Animation flag
   bool anim;
 
@@ -103,6 +318,9 @@ int main(int argc, char** argv)
 	filename = "sample.par";	
   }
 
+  // Keep standard output free for video if it is streamed there
+  if (Bin_sim::video_to_stdout(filename)) cout.rdbuf(std::cerr.rdbuf());
+
   // Welcome message
   cout << Bin_sim_version::full_name << "\n";
   cout << Bin_sim_version::underline << "\n\n";
@@ -110,7 +328,8 @@ int main(int argc, char** argv)
   try {
     // Read parameter file
     cout << "Parsing parameter file...\n";
-    Key_list params(filename);
+    model_params = new Key_list(filename);
+    Key_list &params = *model_params;
 
     // Translate parameter file
     apply_keyword_translation(&params);
@@ -132,11 +351,13 @@ int main(int argc, char** argv)
     if (height < 1) 
       throw Key_list::Value_out_of_range_exception("HEIGHT", ">= 1");
 
-    // Create image writer
-    FB_image_writer writer(width, height);
+    // Create image writer.  It must outlive this block as it is
+    // used while rendering.
+    writer = new FB_image_writer(width, height);
 
     // Create renderer
-    bin_sim = new Bin_sim(params, &writer);
+    Bin_sim::start_vertex_log(params);
+    bin_sim = new Bin_sim(params, writer, &streams);
   } 
   catch (Key_list::File_access_exception e) {
     terminate("File access error: " + e);
@@ -152,15 +373,37 @@ int main(int argc, char** argv)
 	      " - Must be " + e.value);
   }
 
+  // Nothing to draw if every frame has already been saved
+  if (anim && bin_sim->phase.empty()) return 0;
+
   // Main OpenGL initialisation
   cout << "Initialising renderer...\n";
   bin_sim->gl_setup(true);
+  window_accum = bin_sim->antialias && !bin_sim->supersample;
   
   // Define GLUT functions
   glutDisplayFunc(draw);
   glutKeyboardFunc(key);
   if (anim) glutIdleFunc(next_frame);
 
+  // Watch the parameter file of a still image for changes
+  if (!anim) {
+    watcher = new File_watcher(filename);
+    glutTimerFunc(500, check_params, 0);
+  }
+  // Controls for changing the view by hand, which are ignored unless
+  // the model is interactive.  This may change when the model is
+  // rebuilt.
+  glutSpecialFunc(special_key);
+  glutMouseFunc(mouse);
+  glutMotionFunc(motion);
+
+  if (bin_sim->interactive) {
+    cout << "Drag or use the arrow keys to change phase and inclination,\n"
+	 << "drag with the right button to move and use the wheel or +/- "
+	 << "to zoom\n";
+  }
+
   // Begin rendering
   cout << "Rendering...\n";
   glutMainLoop();
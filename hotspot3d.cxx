@@ -38,9 +38,11 @@ Hot_spot_3d::Hot_spot_3d(const int n_steps1,
 			 vector<float> phase, const float q, 
 			 const float inclination, const float mass, 
 			 const float period,  const float r, 
-			 const float size, const float red, 
-			 const float green, const float blue, 
-			 const float opacity, const float timescale) 
+			 const float size, const float red1, 
+			 const float green1, const float blue1, 
+			 const float opacity1, const float timescale1,
+			 Stream_cache &streams, 
+			 const Random_stream &random) 
   : Transparent_object_3d(phase, 4*n_steps1, 2*n_steps1+1, inclination)
 {
   using namespace Sci_const;
@@ -56,22 +58,42 @@ Hot_spot_3d::Hot_spot_3d(const int n_steps1,
   n_theta = 2 * n_steps + 1;
   n_phi = 4 * n_steps;
 
-  // Create stream model and calculate stream-disc impact point
-  Stream stream_model(q, mass, period);
+  // Get stream model and calculate stream-disc impact point
+  Stream &stream_model = streams.get_stream(q, mass, period);
   vector<Vec3> stream = stream_model.stream_calc(0.005, r);
   Vec3 centre = stream[stream.size()-1];
 
+  // Calculate variability model with constant size variations
+  n_granules = new int[n_theta];
+  gran_start = new int[n_theta];
+  int n_gran_total = 0;
+  for (int i = 0 ; i < n_theta ; i++) {
+    float theta = PI * i / (n_theta-1.0f);
+    n_granules[i] = static_cast<int> (n_phi * sin(theta) + 0.5f);
+    gran_start[i] = n_gran_total;
+    n_gran_total += n_granules[i];
+  }
+
+  gran_phase = new float[n_gran_total];
+  polar_phase = new float[n_theta];
+  for (int i = 0 ; i < n_theta ; i++) {
+    Random_stream row_random = random.substream(i);
+    for (j = 0 ; j < n_granules[i] ; j++)
+      gran_phase[gran_start[i] + j] = row_random.uniform() * 2.0f * PI;
+    polar_phase[i] = row_random.uniform() * 2.0f * PI;
+  }
+
+  // Save the phase independent properties needed to calculate colours
+  red = red1;
+  green = green1;
+  blue = blue1;
+  opacity = opacity1;
+  timescale = timescale1;
+
   for (int i = 0 ; i < n_theta ; i++) {
     // Calculate angle of longitude
     float theta = PI * i / (n_theta-1.0f);
 
-    // Calculate variability model with constant size variations
-    int n_granules = static_cast<int> (n_phi * sin(theta) + 0.5f);
-    float *gran_phase = new float[n_granules];
-    for (j = 0 ; j < n_granules ; j++)
-      gran_phase[j] = ((float) rand()) / RAND_MAX * 2.0f * PI;
-    float polar_phase = ((float) rand()) / RAND_MAX * 2.0f * PI;
-    
     for (j = 0 ; j < n_phi ; j++) {
       // Calculate angle of latitude
       float phi = (2.0f * PI * j) / n_phi;
@@ -82,52 +104,86 @@ Hot_spot_3d::Hot_spot_3d(const int n_steps1,
       // Determine index offset for this point
       int index = i * n_phi + j;
 
+      // Assign coordinates
+      *(coord_grid[index])   = centre.x + size * r_vect.x;
+      *(coord_grid[index]+1) = centre.y + size * r_vect.y;
+      *(coord_grid[index]+2) = centre.z + size * r_vect.z;
+    }
+  }
+}
+
+/*
+  Release dynamically allocated memory
+*/
+Hot_spot_3d::~Hot_spot_3d()
+{
+  delete[] n_granules;
+  delete[] gran_start;
+  delete[] gran_phase;
+  delete[] polar_phase;
+}
+
+/*
+  Calculate colours and opacities of the hot spot at one phase
+*/
+void Hot_spot_3d::calc_colours(const int phase_index, const int offset)
+{
+  using Sci_const::PI;
+
+  const int k = phase_index;
+
+  for (int i = 0 ; i < n_theta ; i++) {
+    // Calculate angle of longitude
+    float theta = PI * i / (n_theta-1.0f);
+
+    const float *row_phase = gran_phase + gran_start[i];
+    const int n_gran = n_granules[i];
+
+    for (int j = 0 ; j < n_phi ; j++) {
+      // Calculate angle of latitude
+      float phi = (2.0f * PI * j) / n_phi;
+
+      // Radial vector passing through point
+      Vec3 r_vect(sin(theta)*cos(phi), sin(theta)*sin(phi), cos(theta));
+
+      // Determine index offset for this point
+      int index = i * n_phi + j;
+
       // Define how to interpolate variability
-      float base_ind = phi / 2.0f / PI * n_granules; 
+      float base_ind = phi / 2.0f / PI * n_gran; 
       float int_frac = base_ind - floor(base_ind);
       int ind1 = static_cast<int> (base_ind);
-      int ind2 = (ind1 == n_granules-1) ? 0 : ind1+1;
+      int ind2 = (ind1 == n_gran-1) ? 0 : ind1+1;
 
       // Variability 
       float var_phase, var;
 
-      for (int k = 0 ; k < n_phase ; k++) {
-	// interpolate random structure in hot spot
-	if (i != 0 && i != n_theta-1)
-	  var_phase = (1.0f - int_frac) * gran_phase[ind1] + 
-	    int_frac * gran_phase[ind2];
-	else var_phase = polar_phase;
+      // interpolate random structure in hot spot
+      if (i != 0 && i != n_theta-1)
+	var_phase = (1.0f - int_frac) * row_phase[ind1] + 
+	  int_frac * row_phase[ind2];
+      else var_phase = polar_phase[i];
 
-	var = 2.0f * pow(sin(2.0f * phase[k] / timescale + var_phase), 4.0f);
+      var = 2.0f * pow(sin(2.0f * phase[k] / timescale + var_phase), 4.0f);
 
-	// Calculate transparency
-	float alpha = pow(eye_vec[k] * r_vect, 10) * 1.8f * var; 
+      // Calculate transparency
+      float alpha = pow(eye_vec[k] * r_vect, 10) * 1.8f * var; 
 
-	// Determine phase dependent index for storing colour
-	int index1 = k*n_vert + index;
+      // Determine phase dependent index for storing colour
+      int index1 = offset + index;
 
-	// Assign colours
+      // Assign colours
 #ifdef WIREFRAME
-	red_grid[index1] = 0.0f;      
-	green_grid[index1] = 1.0f;      
-	blue_grid[index1] = 0.0f;
-	alpha_grid[index1] = 1.0f;
+      red_grid[index1] = 0.0f;      
+      green_grid[index1] = 1.0f;      
+      blue_grid[index1] = 0.0f;
+      alpha_grid[index1] = 1.0f;
 #else
-	red_grid[index1] = red;      
-	green_grid[index1] = green;      
-	blue_grid[index1] = blue;
-	alpha_grid[index1] = alpha * opacity;
+      red_grid[index1] = red;      
+      green_grid[index1] = green;      
+      blue_grid[index1] = blue;
+      alpha_grid[index1] = alpha * opacity;
 #endif
-      }
-
-      // Assign coordinates
-      *(coord_grid[index])   = centre.x + size * r_vect.x;
-      *(coord_grid[index]+1) = centre.y + size * r_vect.y;
-      *(coord_grid[index]+2) = centre.z + size * r_vect.z;
     }
-
-    // Clean up
-    delete[] gran_phase;
   }
 }
-
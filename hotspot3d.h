@@ -28,6 +28,8 @@
 
 #include <vector>
 
+#include "random_stream.h"
+#include "stream.h"
 #include "transparent_object3d.h"
 
 #include "binsim_stdinc.h"
@@ -37,15 +39,29 @@
 class Hot_spot_3d : public Transparent_object_3d {
   // Define the surface grid
   int n_steps, n_theta, n_phi;
+
+  // Phases of variability for each line of longitude, stored one row
+  // after another, and at the poles
+  int *n_granules, *gran_start;
+  float *gran_phase, *polar_phase;
+
+  // Colour, opacity and timescale of variability
+  float red, green, blue, opacity, timescale;
+
+  // Calculate colours at one phase
+  void calc_colours(const int phase_index, const int offset);
 public:
   // Constructor
   Hot_spot_3d(const int n_steps1,
 	      vector<float> phase, const float q, 
 	      const float inclination, const float mass, 
 	      const float period, const float r, const float size, 
-	      const float red, const float green, 
-	      const float blue, const float opacity,
-	      const float timescale);
+	      const float red1, const float green1, 
+	      const float blue1, const float opacity1,
+	      const float timescale1, Stream_cache &streams,
+	      const Random_stream &random);
+
+  ~Hot_spot_3d();
 };
 
 /*****************************************************************************/
@@ -23,10 +23,21 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>. 
 */
 
+// Pixel buffer objects are part of OpenGL 2.1
+#ifndef NOGLEXT
+#define GL_GLEXT_PROTOTYPES
+#endif
+
 #include <cstdio>
+#include <cstring>
 
 #include <iostream>
 
+#ifdef WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
 #ifdef __APPLE__
 	#include <GLUT/glut.h>
 #else
@@ -45,12 +56,208 @@ using std::cout;
 
 /*****************************************************************************/
 
+/*
+  Constructor.  Frames are written immediately until encoder threads
+  are requested.
+*/
+Image_writer::Image_writer(const int width1, const int height1)
+{
+  width = width1;
+  height = height1;
+
+  encoders = 0;
+  n_frames = 0;
+  max_frames = 1;
+
+  video = 0;
+  n_video_frames = 0;
+  next_video_frame = 0;
+}
+
+/*
+  Finish writing images and release frame storage
+*/
+Image_writer::~Image_writer()
+{
+  close_video();
+  delete encoders;
+
+  for (unsigned long i = 0 ; i < free_frames.size() ; i++) 
+    delete[] free_frames[i];
+}
+
+/*
+  Write images on background threads.  Rendering continues while up to
+  queue_length frames are waiting to be written, then waits for one to
+  finish.
+*/
+void Image_writer::set_encoder(const int n_threads, const int queue_length)
+{
+  flush();
+  delete encoders;
+  encoders = 0;
+
+  if (n_threads > 0) encoders = new Thread_pool(n_threads);
+  max_frames = (n_threads > 0) ? queue_length : 1;
+}
+
+/*
+  Wait until all images have been written
+*/
+void Image_writer::flush()
+{
+  if (encoders) encoders->wait();
+}
+
+/*
+  Get storage for one frame, waiting for an encoder to release one if
+  all are in use
+*/
+unsigned char *Image_writer::take_frame()
+{
+  std::unique_lock<std::mutex> guard(frame_lock);
+  while (free_frames.empty() && n_frames >= max_frames) 
+    frame_released.wait(guard);
+
+  if (free_frames.empty()) {
+    n_frames++;
+    return new unsigned char[width * height * 3];
+  }
+
+  unsigned char *pixels = free_frames.back();
+  free_frames.pop_back();
+  return pixels;
+}
+
+/*
+  Write a frame, in the background if there are encoder threads
+*/
+void Image_writer::submit_frame(unsigned char *pixels, const string filename,
+				const int format, const int quality)
+{
+  // Video frames must be written in the order they are submitted
+  int frame = (format == Y4M) ? n_video_frames++ : 0;
+
+  if (encoders) 
+    encoders->add_task([this, pixels, filename, format, quality, frame]() 
+		       { encode(pixels, filename, format, quality, frame); });
+  else encode(pixels, filename, format, quality, frame);
+}
+
+/*
+  Write frame to file in given format and release its storage
+*/
+void Image_writer::encode(unsigned char *pixels, const string filename, 
+			  const int format, const int quality, const int frame)
+{
+  if (format == Y4M) encode_y4m(pixels, frame);
 #ifndef NOJPEG
+  else if (format == JPEG) encode_jpeg(pixels, filename, quality);
+#endif
+  else encode_ppm(pixels, filename);
+
+  release_frame(pixels);
+}
+
+/*
+  Allow n more frames to be held at once.  Each thread drawing frames
+  concurrently holds one while drawing.
+*/
+void Image_writer::reserve_frames(const int n)
+{
+  std::unique_lock<std::mutex> guard(frame_lock);
+  max_frames += n;
+}
+
+/*
+  Return frame storage to be used again
+*/
+void Image_writer::release_frame(unsigned char *pixels)
+{
+  {
+    std::unique_lock<std::mutex> guard(frame_lock);
+    free_frames.push_back(pixels);
+  }
+  frame_released.notify_one();
+}
+
+#ifndef NOJPEG
+/*
+  Copy current frame and write it as a JPEG image
+*/
 void Image_writer::write_jpeg(const string filename, const int quality)
+{
+  unsigned char *pixels = take_frame();
+  get_image(pixels);
+  submit_frame(pixels, filename, JPEG, quality);
+}
+#endif
+
+/*
+  Copy current frame and write it as a PPM image
+*/
+void Image_writer::write_ppm(const string filename)
+{
+  unsigned char *pixels = take_frame();
+  get_image(pixels);
+  submit_frame(pixels, filename, PPM, 0);
+}
+
+/*
+  Copy current frame and write it as a PPM image or video frame
+*/
+void Image_writer::queue_frame(const string filename, const int format)
+{
+  unsigned char *pixels = take_frame();
+  get_image(pixels);
+  submit_frame(pixels, filename, format, 0);
+}
+
+/*
+  Start a YUV4MPEG2 stream.  Frames are full resolution 4:4:4 with
+  square pixels.
+*/
+void Image_writer::open_video(const string filename, const int frame_rate)
+{
+  close_video();
+
+  if (filename == "-") {
+    video = stdout;
+#ifdef WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+  } else if ((video = fopen(filename.c_str(), "wb")) == NULL) 
+    exit(1);
+
+  fprintf(video, "YUV4MPEG2 W%i H%i F%i:1 Ip A1:1 C444\n", 
+	  width, height, frame_rate);
+
+  n_video_frames = 0;
+  next_video_frame = 0;
+}
+
+/*
+  Write outstanding frames and end the video stream
+*/
+void Image_writer::close_video()
+{
+  if (!video) return;
+
+  flush();
+
+  if (video == stdout) fflush(video);
+  else fclose(video);
+  video = 0;
+}
+
+/*****************************************************************************/
+
+#ifndef NOJPEG
+void Image_writer::encode_jpeg(const unsigned char *pixels, 
+			       const string filename, const int quality)
 {
   // Pointer to row storage 
   JSAMPROW scanline_ptr[1];
-  scanline_ptr[0] = jpeg_scanline;
 
   // Allocate and initialise JPEG compression object
   struct jpeg_compress_struct cinfo;
@@ -77,7 +284,7 @@ void Image_writer::write_jpeg(const string filename, const int quality)
 
   // Write scanlines
   for (int i = 0 ; i < height ; i++) {
-    get_jpeg_scanline(i);
+    scanline_ptr[0] = const_cast<unsigned char *> (pixels + i * width * 3);
     jpeg_write_scanlines(&cinfo, scanline_ptr, 1);
   }
   
@@ -96,7 +303,7 @@ void Image_writer::write_jpeg(const string filename, const int quality)
   PPM writer adapted from osdemo.c in Mesa distribution (Joerg
   Schmalzl, Brian Paul)
 */
-void Image_writer::write_ppm(const string filename)
+void Image_writer::encode_ppm(unsigned char *pixels, const string filename)
 {
   // Specify destination for image data
    FILE *outfile; 
@@ -114,22 +321,18 @@ void Image_writer::write_ppm(const string filename)
    if ((outfile = fopen(filename.c_str(), "ab")) == NULL) 
      exit(1);
 
-   // Write each component of each pixel in turn
-   for (int y = 0 ; y < height ; y++) {
-     for (int x = 0 ; x < width ; x++) {
-       // Need RGB on Unix, GBR on Windows.  Why?!
+   // Need RGB on Unix, GBR on Windows.  Why?!
 #ifdef WIN32
-       fputc(get_green(x,y), outfile);
-       fputc(get_blue(x,y), outfile);
-       fputc(get_red(x,y), outfile);
-#else
-       fputc(get_red(x,y), outfile);
-       fputc(get_green(x,y), outfile);
-       fputc(get_blue(x,y), outfile);
-
-#endif
-     }
+   for (int i = 0 ; i < width * height * 3 ; i += 3) {
+     unsigned char red = pixels[i];
+     pixels[i] = pixels[i+1];
+     pixels[i+1] = pixels[i+2];
+     pixels[i+2] = red;
    }
+#endif
+
+   // Write all pixels in one go
+   fwrite(pixels, 3, width * height, outfile);
    
    // Close output file
    fclose(outfile);
@@ -137,120 +340,316 @@ void Image_writer::write_ppm(const string filename)
 
 /*****************************************************************************/
 
-#ifndef NOJPEG
 /*
-  Populate scanline with given row from framebuffer
+  Convert n RGB pixels to separate Y, U and V planes (ITU-R BT.601,
+  studio range) in 8 bit fixed point.  The offsets keep every sum
+  positive and there are no branches, so the loop can be vectorised.
 */
-void FB_image_writer::get_jpeg_scanline(const int row) 
+static void rgb_to_yuv(const unsigned char *rgb, unsigned char *y, 
+		       unsigned char *u, unsigned char *v, const int n)
 {
-  // Read whole scanline in one go
-  glReadPixels(0, height-row-1, width, 1, GL_RGB, GL_UNSIGNED_BYTE, 
-	       jpeg_scanline); 
+  for (int i = 0 ; i < n ; i++) {
+    int red = rgb[3*i], green = rgb[3*i+1], blue = rgb[3*i+2];
+
+    y[i] = (66*red + 129*green + 25*blue + 4224) >> 8;
+    u[i] = (-38*red - 74*green + 112*blue + 32896) >> 8;
+    v[i] = (112*red - 94*green - 18*blue + 32896) >> 8;
+  }
 }
-#endif
 
-unsigned char FB_image_writer::get_red(const int column, const int row)
+/*
+  Convert frame to YUV and append it to the video stream once all
+  earlier frames have been written
+*/
+void Image_writer::encode_y4m(const unsigned char *pixels, const int frame)
 {
-  // Read just red component
-  unsigned char result;
-  glReadPixels(column, height-row-1, 1, 1, GL_RED, GL_UNSIGNED_BYTE, 
-	       &result);
-  return result;
+  const int n_pixels = width * height;
+  vector<unsigned char> yuv(n_pixels * 3);
+  rgb_to_yuv(pixels, &yuv[0], &yuv[n_pixels], &yuv[2*n_pixels], n_pixels);
+
+  std::unique_lock<std::mutex> guard(video_lock);
+  while (frame != next_video_frame) video_written.wait(guard);
+
+  fprintf(video, "FRAME\n");
+  fwrite(&yuv[0], 1, yuv.size(), video);
+
+  next_video_frame++;
+  video_written.notify_all();
 }
 
-unsigned char FB_image_writer::get_green(const int column, const int row)
+/*****************************************************************************/
+
+/*
+  Constructor.  Pixel buffers are not created until the first frame
+  is queued, when there is certain to be an OpenGL context.
+*/
+FB_image_writer::FB_image_writer(const int width1, const int height1)
+  : Image_writer(width1, height1)
 {
-  // Read just green component
-  unsigned char result;
-  glReadPixels(column, height-row-1, 1, 1, GL_GREEN, GL_UNSIGNED_BYTE, 
-	       &result);
-  return result;
+  pixel_buffer[0] = pixel_buffer[1] = 0;
+  queued[0] = queued[1] = false;
+  next_buffer = 0;
+  buffers_checked = false;
+  use_buffers = false;
 }
 
-unsigned char FB_image_writer::get_blue(const int column, const int row)
+/*
+  Release pixel buffers
+*/
+FB_image_writer::~FB_image_writer()
 {
-  // Read just blue component
-  unsigned char result;
-  glReadPixels(column, height-row-1, 1, 1, GL_BLUE, GL_UNSIGNED_BYTE, 
-	       &result);
-  return result;
+#ifndef NOGLEXT
+  if (use_buffers) glDeleteBuffers(2, pixel_buffer);
+#endif
 }
 
-/*****************************************************************************/
-
-#ifndef NOJPEG
 /*
-  Populate scanline with given row from 32bpp off-screen buffer
+  Populate storage with the whole framebuffer in one read
 */
-void OS_image_writer::get_jpeg_scanline(const int row) 
+void FB_image_writer::get_image(unsigned char *pixels)
 {
-  for (int j = 0 ; j < width ; j++) {
-    // Base index for pixel
-    int buffer_index = ((height-row-1)*width + j) * 4;
-
-    // One colour component at a time
-    jpeg_scanline[j*3]   = buffer[buffer_index];
-    jpeg_scanline[j*3+1] = buffer[buffer_index+1];
-    jpeg_scanline[j*3+2] = buffer[buffer_index+2];
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+  // Turn the image the right way up
+  const int row_size = width * 3;
+  vector<unsigned char> row(row_size);
+  for (int i = 0 ; i < height / 2 ; i++) {
+    unsigned char *top = pixels + i * row_size;
+    unsigned char *bottom = pixels + (height-i-1) * row_size;
+    memcpy(&row[0], top, row_size);
+    memcpy(top, bottom, row_size);
+    memcpy(bottom, &row[0], row_size);
   }
 }
+
+/*
+  Create a pair of pixel buffers to read frames into, if OpenGL 2.1
+  is available
+*/
+void FB_image_writer::init_buffers()
+{
+  buffers_checked = true;
+
+#ifndef NOGLEXT
+  int major = 0, minor = 0;
+  const char *version = 
+    reinterpret_cast<const char *> (glGetString(GL_VERSION));
+  if (version) sscanf(version, "%d.%d", &major, &minor);
+  if (major < 2 || (major == 2 && minor < 1)) return;
+
+  glGenBuffers(2, pixel_buffer);
+  for (int i = 0 ; i < 2 ; i++) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer[i]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 3, 0, 
+		 GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  use_buffers = true;
 #endif
+}
 
-unsigned char OS_image_writer::get_red(const int column, const int row)
+/*
+  Start reading the current frame into the next pixel buffer, and
+  write the frame read on the previous call.  By the time this is
+  called that read will normally be complete, so neither waits for
+  the other.
+*/
+void FB_image_writer::queue_frame(const string filename, const int format)
 {
-  // Read just red component
-  return buffer[((height-row-1)*width + column) * 4];
+  if (!buffers_checked) init_buffers();
+
+  if (!use_buffers) {
+    Image_writer::queue_frame(filename, format);
+    return;
+  }
+
+#ifndef NOGLEXT
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer[next_buffer]);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  queued_file[next_buffer] = filename;
+  queued_format[next_buffer] = format;
+  queued[next_buffer] = true;
+
+  next_buffer = 1 - next_buffer;
+  if (queued[next_buffer]) write_buffer(next_buffer);
+#endif
 }
 
-unsigned char OS_image_writer::get_green(const int column, const int row)
+/*
+  Write any frames still held in pixel buffers, oldest first
+*/
+void FB_image_writer::flush()
 {
-  // Read just green component
-  return buffer[((height-row-1)*width + column) * 4 + 1];
+  for (int i = 0 ; i < 2 ; i++) {
+    if (queued[next_buffer]) write_buffer(next_buffer);
+    next_buffer = 1 - next_buffer;
+  }
+
+  Image_writer::flush();
 }
 
-unsigned char OS_image_writer::get_blue(const int column, const int row)
+/*
+  Write the frame held in a pixel buffer
+*/
+void FB_image_writer::write_buffer(const int i)
 {
-  // Read just blue component
-  return buffer[((height-row-1)*width + column) * 4 + 2];
+  unsigned char *pixels = take_frame();
+
+#ifndef NOGLEXT
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer[i]);
+  const unsigned char *data = static_cast<const unsigned char *> 
+    (glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+
+  // Copy rows into image, turning it the right way up
+  if (data) {
+    const int row_size = width * 3;
+    for (int row = 0 ; row < height ; row++)
+      memcpy(pixels + row * row_size, data + (height-row-1) * row_size, 
+	     row_size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else cout << "Failed to read back frame\n";
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+
+  submit_frame(pixels, queued_file[i], queued_format[i], 0);
+  queued[i] = false;
 }
 
 /*****************************************************************************/
 
-#ifndef NOJPEG
 /*
-  Populate scanline with given row from  64bpp off-screen buffer
+  Populate storage from 32bpp off-screen buffer
 */
-void OS16_image_writer::get_jpeg_scanline(const int row) 
+void OS_image_writer::get_image(unsigned char *pixels)
 {
-  for (int j = 0 ; j < width ; j++) {
-    // Base index for pixel
-    int buffer_index = ((height-row-1)*width + j) * 4;
-
-    // One colour component at a time
-    jpeg_scanline[j*3]   = (buffer[buffer_index] >> 8);
-    jpeg_scanline[j*3+1] = (buffer[buffer_index+1] >> 8);
-    jpeg_scanline[j*3+2] = (buffer[buffer_index+2] >> 8);
+  for (int row = 0 ; row < height ; row++) {
+    for (int j = 0 ; j < width ; j++) {
+      // Base indices for pixel
+      int buffer_index = ((height-row-1)*width + j) * 4;
+      int pixel_index = (row*width + j) * 3;
+
+      // One colour component at a time
+      pixels[pixel_index]   = buffer[buffer_index];
+      pixels[pixel_index+1] = buffer[buffer_index+1];
+      pixels[pixel_index+2] = buffer[buffer_index+2];
+    }
   }
 }
-#endif
 
-unsigned char OS16_image_writer::get_red(const int column, const int row)
+/*****************************************************************************/
+
+/*
+  Populate storage from 64bpp off-screen buffer
+*/
+void OS16_image_writer::get_image(unsigned char *pixels)
 {
-  // Read just red component
-  return buffer[((height-row-1)*width + column) * 4] >> 8;
+  for (int row = 0 ; row < height ; row++) {
+    for (int j = 0 ; j < width ; j++) {
+      // Base indices for pixel
+      int buffer_index = ((height-row-1)*width + j) * 4;
+      int pixel_index = (row*width + j) * 3;
+
+      // One colour component at a time
+      pixels[pixel_index]   = (buffer[buffer_index] >> 8);
+      pixels[pixel_index+1] = (buffer[buffer_index+1] >> 8);
+      pixels[pixel_index+2] = (buffer[buffer_index+2] >> 8);
+    }
+  }
 }
 
-unsigned char OS16_image_writer::get_green(const int column, const int row)
+
+
+
+/*****************************************************************************/
+
+#ifndef NOJPEG
+/*
+  JPEG compression objects, kept out of the header
+*/
+struct Scanline_writer::Jpeg_state {
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+};
+#endif
+
+/*
+  Open the output file and write the header
+*/
+Scanline_writer::Scanline_writer(const string filename, const int width1, 
+				 const int height1, const int format1, 
+				 const int quality)
 {
-  // Read just green component
-  return buffer[((height-row-1)*width + column) * 4 + 1] >> 8;
+  width = width1;
+  height = height1;
+  format = format1;
+
+  if ((outfile = fopen(filename.c_str(), "wb")) == NULL) 
+    exit(1);
+
+#ifndef NOJPEG
+  jpeg = 0;
+  if (format == Image_writer::JPEG) {
+    jpeg = new Jpeg_state;
+    jpeg->cinfo.err = jpeg_std_error(&jpeg->jerr);
+    jpeg_create_compress(&jpeg->cinfo);
+    jpeg_stdio_dest(&jpeg->cinfo, outfile);
+
+    // Set compression parameters
+    jpeg->cinfo.image_width = width;
+    jpeg->cinfo.image_height = height;
+    jpeg->cinfo.input_components = 3;
+    jpeg->cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&jpeg->cinfo);
+    jpeg_set_quality (&jpeg->cinfo, quality, TRUE);
+
+    // Start compression
+    jpeg_start_compress(&jpeg->cinfo, TRUE);
+    return;
+  }
+#endif
+
+  // Write PPM header
+  fprintf(outfile, "P6\n");
+  fprintf(outfile, "# PPM file created by BinSim\n");
+  fprintf(outfile, "%i %i\n", width, height);
+  fprintf(outfile, "255\n");
 }
 
-unsigned char OS16_image_writer::get_blue(const int column, const int row)
+/*
+  Finish compression and close the file
+*/
+Scanline_writer::~Scanline_writer()
 {
-  // Read just blue component
-  return buffer[((height-row-1)*width + column) * 4 + 2] >> 8;
-}
+#ifndef NOJPEG
+  if (jpeg) {
+    jpeg_finish_compress(&jpeg->cinfo);
+    jpeg_destroy_compress(&jpeg->cinfo);
+    delete jpeg;
+  }
+#endif
 
+  fclose(outfile);
+}
 
+/*
+  Write rows of RGB bytes, top row first
+*/
+void Scanline_writer::write_rows(const unsigned char *rows, const int n_rows)
+{
+#ifndef NOJPEG
+  if (jpeg) {
+    for (int i = 0 ; i < n_rows ; i++) {
+      JSAMPROW scanline_ptr[1];
+      scanline_ptr[0] = const_cast<unsigned char *> (rows + i * width * 3);
+      jpeg_write_scanlines(&jpeg->cinfo, scanline_ptr, 1);
+    }
+    return;
+  }
+#endif
 
+  fwrite(rows, 3, width * n_rows, outfile);
+}
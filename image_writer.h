@@ -26,39 +26,102 @@
 #ifndef _IMAGE_WRITER_H
 #define _IMAGE_WRITER_H
 
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#include "thread_pool.h"
 
 #include "binsim_stdinc.h"
 
 using std::string;
+using std::vector;
 
 /*****************************************************************************/
 
 /*
-  Abstract superclass to define output functionality
+  Abstract superclass to define output functionality.  Frames are
+  copied into storage taken from a fixed set and written from there,
+  optionally by background encoder threads, so that rendering only
+  waits for a frame to be copied unless all storage is in use.
 */
 class Image_writer {
-protected:
-  // Image dimensions
-  int width, height;
+  // Threads writing images, or 0 to write them immediately
+  Thread_pool *encoders;
+
+  // Storage for frames not being used, number of frames allocated and
+  // the maximum allowed
+  vector<unsigned char *> free_frames;
+  int n_frames, max_frames;
+
+  // Synchronisation of the above
+  std::mutex frame_lock;
+  std::condition_variable frame_released;
+
+  // Video stream, number of frames submitted to it and number written
+  FILE *video;
+  int n_video_frames, next_video_frame;
 
-  // Storage for one line as one byte per colour per pixel
-  unsigned char *jpeg_scanline;
+  // Synchronisation of video frames, which are written in order
+  std::mutex video_lock;
+  std::condition_variable video_written;
+
+  // Write frame to file in given format and release its storage.
+  // Video frames are numbered from 0.
+  void encode(unsigned char *pixels, const string filename, 
+	      const int format, const int quality, const int frame);
 
 #ifndef NOJPEG
-  // Populate scanline with given row
-  virtual void get_jpeg_scanline(const int row) = 0;
+  // Write frame as a JPEG file
+  void encode_jpeg(const unsigned char *pixels, const string filename,
+		   const int quality);
 #endif
 
-  // Get colour components as bytes
-  virtual unsigned char get_red(const int column, const int row) = 0;
-  virtual unsigned char get_green(const int column, const int row) = 0;
-  virtual unsigned char get_blue(const int column, const int row) = 0;
+  // Write frame as a PPM file
+  void encode_ppm(unsigned char *pixels, const string filename);
+
+  // Append frame to the video stream
+  void encode_y4m(const unsigned char *pixels, const int frame);
+
+  // Not copyable
+  Image_writer(const Image_writer&);
+  Image_writer& operator= (const Image_writer&);
+protected:
+  // Image dimensions
+  int width, height;
+
+  // Populate storage with the whole frame as one byte per colour per
+  // pixel, top row first
+  virtual void get_image(unsigned char *pixels) = 0;
 public:
   // Constructor
-  Image_writer(const int width1, const int height1)
-    : width(width1), height(height1) 
-  { jpeg_scanline = new unsigned char[width*3]; }
+  Image_writer(const int width1, const int height1);
+
+  virtual ~Image_writer();
+
+  // Write images on background threads, holding up to queue_length
+  // frames waiting to be written
+  void set_encoder(const int n_threads, const int queue_length);
+
+  // Get storage for one frame, waiting if all are in use
+  unsigned char *take_frame();
+
+  // Return storage taken with take_frame without writing it
+  void release_frame(unsigned char *pixels);
+
+  // Allow n more frames to be held at once, for threads drawing
+  // frames concurrently
+  void reserve_frames(const int n);
+
+  // Copy the current frame into storage
+  void copy_frame(unsigned char *pixels) { get_image(pixels); }
+
+  // Write a frame taken with take_frame, in the background if there
+  // are encoder threads.  The storage is released once written.
+  void submit_frame(unsigned char *pixels, const string filename, 
+		    const int format, const int quality);
 
 #ifndef NOJPEG
   // Write Jpeg image
@@ -68,8 +131,24 @@ public:
   // Write PPM image
   void write_ppm(const string filename);
 
+  // Write PPM image or video frame, possibly not until a later frame
+  // has been drawn.  The filename is ignored for video frames.  The
+  // default is to write it immediately.
+  virtual void queue_frame(const string filename, const int format);
+
+  // Start a YUV4MPEG2 video stream with the given frame rate, written
+  // to a file or named pipe, or to standard output if the filename is
+  // -
+  void open_video(const string filename, const int frame_rate);
+
+  // Write outstanding frames and end the video stream
+  void close_video();
+
+  // Wait until all images have been written
+  virtual void flush();
+
   // Allowed formats
-  enum { PPM, JPEG};
+  enum { PPM, JPEG, Y4M};
 };
 
 /*****************************************************************************/
@@ -78,19 +157,38 @@ public:
   Image writer for framebuffer images
 */
 class FB_image_writer : public Image_writer {
-#ifndef NOJPEG
-  // Populate scanline with given row
-  void get_jpeg_scanline(const int row); 
-#endif
+  // Pixel buffer objects that alternate frames are read into, and the
+  // files and formats waiting to be written from them
+  GLuint pixel_buffer[2];
+  string queued_file[2];
+  int queued_format[2];
+  bool queued[2];
+  int next_buffer;
+
+  // Whether pixel buffers have been set up, and whether they are
+  // supported
+  bool buffers_checked, use_buffers;
+
+  // Populate storage with the whole frame in one read
+  void get_image(unsigned char *pixels);
+
+  // Create pixel buffers if supported
+  void init_buffers();
 
-  // Get colour components as bytes
-  unsigned char get_red(const int column, const int row);
-  unsigned char get_green(const int column, const int row);
-  unsigned char get_blue(const int column, const int row);
+  // Write the frame held in a pixel buffer
+  void write_buffer(const int i);
 public:
   // Constructor
-  FB_image_writer(const int width1, const int height1)
-    : Image_writer(width1, height1) { }
+  FB_image_writer(const int width1, const int height1);
+
+  ~FB_image_writer();
+
+  // Start reading the frame into a pixel buffer and write the
+  // previous frame
+  void queue_frame(const string filename, const int format);
+
+  // Write any frames still held in pixel buffers
+  void flush();
 };
 
 /*****************************************************************************/
@@ -102,15 +200,8 @@ class OS_image_writer : public Image_writer {
   // Pointer to image buffer
   const GLubyte *buffer;
 
-#ifndef NOJPEG
-  // Populate scanline with given row
-  void get_jpeg_scanline(const int row);
-#endif
-
-  // Get colour components as bytes
-  unsigned char get_red(const int column, const int row);
-  unsigned char get_green(const int column, const int row);
-  unsigned char get_blue(const int column, const int row);
+  // Populate storage with the whole frame
+  void get_image(unsigned char *pixels);
 public:
   // Constructor
   OS_image_writer(const int width1, const int height1, const GLubyte *buffer1)
@@ -126,15 +217,8 @@ class OS16_image_writer : public Image_writer {
   // Pointer to image buffer
   const GLushort *buffer;
 
-#ifndef NOJPEG
-  // Populate scanline with given row
-  void get_jpeg_scanline(const int row); 
-#endif
-
-  // Get colour components as bytes
-  unsigned char get_red(const int column, const int row);
-  unsigned char get_green(const int column, const int row);
-  unsigned char get_blue(const int column, const int row);
+  // Populate storage with the whole frame
+  void get_image(unsigned char *pixels);
 public:
   // Constructor
   OS16_image_writer(const int width1, const int height1, 
@@ -144,4 +228,37 @@ public:
 
 /*****************************************************************************/
 
+/*
+  Writer for images supplied a few scanlines at a time from top to
+  bottom, so that the whole image is never held in memory
+*/
+class Scanline_writer {
+  // Image dimensions and format
+  int width, height, format;
+
+  // Output file
+  FILE *outfile;
+
+#ifndef NOJPEG
+  // JPEG compression state
+  struct Jpeg_state;
+  Jpeg_state *jpeg;
+#endif
+
+  // Not copyable
+  Scanline_writer(const Scanline_writer&);
+  Scanline_writer& operator= (const Scanline_writer&);
+public:
+  // Constructor opens the file and writes the header.  The
+  // destructor completes the file.
+  Scanline_writer(const string filename, const int width1, 
+		  const int height1, const int format1, const int quality);
+  ~Scanline_writer();
+
+  // Write rows of RGB bytes, the top row first
+  void write_rows(const unsigned char *rows, const int n_rows);
+};
+
+/*****************************************************************************/
+
 #endif
@@ -39,7 +39,7 @@ Jet_3d::Jet_3d(const int n_phi1, const vector<float> phase, const float q,
 	       const float inclination, const float opening_angle, 
 	       const float red1, const float green1, const float blue1,
 	       const float red2, const float green2, const float blue2,
-	       const float opacity, const float gradient,
+	       const float opacity1, const float gradient1,
 	       const float jet_inc, const float jet_phi)
   : Transparent_object_3d(phase, n_phi1, 4, inclination)
 {
@@ -54,15 +54,18 @@ Jet_3d::Jet_3d(const int n_phi1, const vector<float> phase, const float q,
   float radius = 10.0f * tan(opening_angle / 360.0f * 2.0f * PI);
 
   // Calculate non-rotating inertial frame
-  Vec3 fixed_eye_vec;
-  float inc_angle = -2.0f * PI * inclination / 360.f;
-  float phase_angle = 2.0f * PI * (jet_phi+270.0f) / 360.0f;
-
-  // This is not the correct eye vector; the jet inclination has not
-  // been taken into account.  It does produce the desired effect, though.
-  fixed_eye_vec.x = cos(phase_angle) * sin(inc_angle);
-  fixed_eye_vec.y = -sin(phase_angle) * sin(inc_angle);
-  fixed_eye_vec.z = cos(inc_angle);
+  rotation = jet_phi;
+  Jet_3d::set_inclination(inclination);
+
+  // Save the properties needed to calculate colours
+  red_up = red1;
+  green_up = green1;
+  blue_up = blue1;
+  red_down = red2;
+  green_down = green2;
+  blue_down = blue2;
+  opacity = opacity1;
+  gradient = gradient1;
 
   for (int i = 0 ; i < 4 ; i++) {
     for (int j = 0 ; j < n_phi ; j++) {
@@ -75,26 +78,6 @@ Jet_3d::Jet_3d(const int n_phi1, const vector<float> phase, const float q,
       // Determine index offset for this point
       int index = i*n_phi + j;
 
-      for (int k = 0 ; k < n_phase ; k++) {
-	// Calculate transparency
-	float alpha = pow(fixed_eye_vec * r_vect, gradient) * opacity; 
-
-	// Determine phase dependent index for storing colour
-	int index1 = k*n_vert + index;
-
-	// Assign colours
-	if (i <= 1) {
-	  red_grid[index1] = red1;      
-	  green_grid[index1] = green1;      
-	  blue_grid[index1] = blue1;
-	} else {
-	  red_grid[index1] = red2;      
-	  green_grid[index1] = green2;      
-	  blue_grid[index1] = blue2;
-	}
-	alpha_grid[index1] = alpha * 0.5f;
-      }
-
       // Assign coordinates
       if (i == 0) {
 	// End of upper jet
@@ -116,3 +99,59 @@ Jet_3d::Jet_3d(const int n_phi1, const vector<float> phase, const float q,
   }
 }
 
+/*
+  Change the inclination of the binary, recalculating the fixed
+  direction of the observer as well as those at each phase
+*/
+void Jet_3d::set_inclination(const float inclination)
+{
+  using Sci_const::PI;
+
+  Object_3d::set_inclination(inclination);
+
+  float inc_angle = -2.0f * PI * inclination / 360.f;
+  float phase_angle = 2.0f * PI * (rotation+270.0f) / 360.0f;
+
+  // This is not the correct eye vector; the jet inclination has not
+  // been taken into account.  It does produce the desired effect, though.
+  fixed_eye_vec.x = cos(phase_angle) * sin(inc_angle);
+  fixed_eye_vec.y = -sin(phase_angle) * sin(inc_angle);
+  fixed_eye_vec.z = cos(inc_angle);
+}
+
+/*
+  Calculate colours and opacities of the jet at one phase.  The jet
+  is fixed in the inertial frame, so these do not change with phase.
+*/
+void Jet_3d::calc_colours(const int phase_index, const int offset)
+{
+  using Sci_const::PI;
+
+  for (int i = 0 ; i < 4 ; i++) {
+    for (int j = 0 ; j < n_phi ; j++) {
+      // Calculate angle of latitude
+      float phi = (2.0f * PI * j) / n_phi;
+
+      // Radial vector passing through point
+      Vec3 r_vect(cos(phi), sin(phi), 0.0f);
+
+      // Calculate transparency
+      float alpha = pow(fixed_eye_vec * r_vect, gradient) * opacity; 
+
+      // Determine phase dependent index for storing colour
+      int index1 = offset + i*n_phi + j;
+
+      // Assign colours
+      if (i <= 1) {
+	red_grid[index1] = red_up;      
+	green_grid[index1] = green_up;      
+	blue_grid[index1] = blue_up;
+      } else {
+	red_grid[index1] = red_down;      
+	green_grid[index1] = green_down;      
+	blue_grid[index1] = blue_down;
+      }
+      alpha_grid[index1] = alpha * 0.5f;
+    }
+  }
+}
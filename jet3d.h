@@ -37,14 +37,29 @@
 class Jet_3d : public Transparent_object_3d {
   // Define the surface grid
   int n_phi;
+
+  // Colours of the upper and lower jets, opacity and gradient
+  float red_up, green_up, blue_up, red_down, green_down, blue_down;
+  float opacity, gradient;
+
+  // Fixed direction of the observer, and the rotation of the jet
+  // used to find it
+  Vec3 fixed_eye_vec;
+  float rotation;
+
+  // Calculate colours at one phase
+  void calc_colours(const int phase_index, const int offset);
 public:
   // Constructor
   Jet_3d(const int n_phi1, const vector<float> phase, const float q, 
 	 const float inclination, const float opening_angle, 
 	 const float red1, const float green1, const float blue1,
 	 const float red2, const float green2, const float blue2,
-	 const float opacity, const float gradient,
+	 const float opacity1, const float gradient1,
 	 const float jet_inc, const float jet_phi);
+
+  // Change the inclination of the binary
+  void set_inclination(const float inclination);
 };
 
 /*****************************************************************************/
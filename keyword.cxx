@@ -28,8 +28,10 @@
 #include <cstdio>
 #include <cstring>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include "keyword.h"
 #include "stringutil.h"
@@ -350,6 +352,45 @@ bool Key_list::get_bool(string key)
   else throw File_format_exception(key + " = " + value);
 }
 
+/*
+  Function to return each keyword in the list once, in the order in
+  which they first appear
+*/
+vector<string> Key_list::get_keys()
+{
+  vector<string> keys;
+
+  for (Key_item *this_item = first_item ; this_item ; 
+       this_item = this_item->goto_next())
+    if (std::find(keys.begin(), keys.end(), this_item->keyword) == keys.end())
+      keys.push_back(this_item->keyword);
+
+  return keys;
+}
+
+/*
+  Function to list the keywords whose values differ from those in
+  another list, including keywords found in only one of the lists
+*/
+vector<string> Key_list::changed_keys(Key_list &other)
+{
+  vector<string> changed;
+  vector<string> keys = get_keys();
+  vector<string> other_keys = other.get_keys();
+
+  for (unsigned i = 0 ; i < keys.size() ; i++)
+    if (std::find(other_keys.begin(), other_keys.end(), keys[i]) == 
+	other_keys.end() ||
+	get_value(keys[i]) != other.get_value(keys[i]))
+      changed.push_back(keys[i]);
+
+  for (unsigned i = 0 ; i < other_keys.size() ; i++)
+    if (std::find(keys.begin(), keys.end(), other_keys[i]) == keys.end())
+      changed.push_back(other_keys[i]);
+
+  return changed;
+}
+
 /*
   Function to read a list of keywords from a file
 */
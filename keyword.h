@@ -28,10 +28,12 @@
 #define _KEYWORD_H
 
 #include <string>
+#include <vector>
 
 #include "binsim_stdinc.h"
 
 using std::string;
+using std::vector;
 
 /*****************************************************************************/
 
@@ -101,6 +103,13 @@ public:
   int get_int(string key);
   float get_float(string key);
   bool get_bool(string key);
+
+  // Function to return each keyword in the list once, in order
+  vector<string> get_keys();
+
+  // Function to return the keywords whose values differ from those
+  // in another list
+  vector<string> changed_keys(Key_list &other);
   
   // Function to read in a list from a file
   void read_file(string filename);
@@ -44,9 +44,11 @@ Lobe_3d::Lobe_3d(const int n_steps1, const vector<float> phase, const float q,
 		 const float mass, const float t_pole, 
 		 const float t_min,
 		 const float l_irrad, const float disc_thick,
-		 const float granulation_amplitude, 
-		 const float granulation_period,
-		 const float fill, BB_color_model &cm, const bool primary)
+		 const float granulation_amplitude1, 
+		 const float granulation_period1,
+		 const float fill, BB_color_model &cm1, const bool primary,
+		 Thread_pool &pool1, const Random_stream &random, 
+		 const Roche_atlas *atlas)
   : Object_3d(phase, 4*n_steps1, 2*n_steps1+1, inclination)
 {
   using namespace Sci_const;
@@ -62,106 +64,229 @@ Lobe_3d::Lobe_3d(const int n_steps1, const vector<float> phase, const float q,
   // Create Roche lobe model to describe object
   Roche_star lobe(q, t_pole, period, mass, fill);
   lobe.enable_irradiation(l_irrad, disc_thick, 0.5f, true);
+  lobe.use_atlas(atlas);
+  lobe.prepare();
  
-  // Angles specifying a point on the surface
-  float theta, phi;
+  // Properties of every point on the surface.  The lobe is symmetric
+  // about the orbital plane and the plane containing the line of
+  // centres, so only latitudes from the pole to the equator and
+  // longitudes from 0 to PI are calculated and the rest are reflected
+  // from these
+  Surface_properties *surf_grid = new Surface_properties[n_lat * n_long];
 
-  // Properties of a point on the surface
-  Surface_properties surf;
-  float temp, tirr, temp1;
-  Vec3 rgb;
+  const int n_half = n_long / 2 + 1;
 
-  // Index variables
-  int j, index;
+  // Each line of latitude is independent, so they are shared between
+  // threads
+  pool1.parallel_for(0, n_steps+1, [&](int i) {
+      Surface_properties *surf_row = surf_grid + i * n_long;
 
-  for (int i = 0 ; i < n_lat ; i++) {
-    // Calculate angle of latitude
-    theta = PI * i / n_lat;    
-
-    // Calculate granulation model with constant size granulations
-    int n_granules = static_cast<int> (n_long * sin(theta) + 0.5f);
-    n_granules = (n_granules > 1) ? n_granules : 1; 
-
-    //float granulation[n_granules];
-    float *gran_phase = new float[n_granules];
-    for (j = 0 ; j < n_granules ; j++)
-      gran_phase[j] = ((float) rand()) / RAND_MAX * 2.0f * PI;
-
-    for (j = 0 ; j < n_long ; j++) {
-      // Calculate angle of longitude
-      phi = (2.0f * PI * j) / n_long;
-
-      // Determine index offset for this point
-      index = i * n_long + j;
-
-      // Get properties of the point on the surface
-      surf = lobe.get_surface_properties(theta, phi);
-      temp = surf.temp;
-      
-      // Invert coordinates and normals for companion
-      if (primary) {
-	surf.coords.x = -surf.coords.x;
-	surf.coords.y = -surf.coords.y;
-	surf.normal.x = -surf.normal.x;
-	surf.normal.y = -surf.normal.y;
+      // Calculate half of this line of latitude
+      float *theta_row = new float[n_half];
+      float *phi_row = new float[n_half];
+      for (int j = 0 ; j < n_half ; j++) {
+	theta_row[j] = PI * i / n_lat;
+	phi_row[j] = (2.0f * PI * j) / n_long;
+      }
+      lobe.get_surface_properties(n_half, theta_row, phi_row, surf_row);
+      delete[] theta_row;
+      delete[] phi_row;
+
+      // Reflect in the plane containing the line of centres
+      for (int j = n_half ; j < n_long ; j++) {
+	surf_row[j] = surf_row[n_long - j];
+	surf_row[j].coords.y = -surf_row[j].coords.y;
+	surf_row[j].normal.y = -surf_row[j].normal.y;
       }
+    });
+
+  // Reflect the remaining lines of latitude in the orbital plane
+  for (int i = n_steps+1 ; i < n_lat ; i++) {
+    Surface_properties *surf_row = surf_grid + i * n_long;
+    const Surface_properties *mirror_row = surf_grid + (n_lat - i) * n_long;
+    for (int j = 0 ; j < n_long ; j++) {
+      surf_row[j] = mirror_row[j];
+      surf_row[j].coords.z = -surf_row[j].coords.z;
+      surf_row[j].normal.z = -surf_row[j].normal.z;
+    }
+  }
 
-      // Enforce minimum temperature
-      temp = (temp > t_pole * t_min) ? temp : t_pole * t_min;
+  // Calculate granulation model with constant size granulations.
+  // Granule phases are drawn from a stream keyed by the line of
+  // latitude, so they do not depend on how rows are scheduled
+  n_granules = new int[n_lat];
+  gran_start = new int[n_lat];
+  int n_gran_total = 0;
+  for (int i = 0 ; i < n_lat ; i++) {
+    float theta = PI * i / n_lat;    
+    n_granules[i] = static_cast<int> (n_long * sin(theta) + 0.5f);
+    n_granules[i] = (n_granules[i] > 1) ? n_granules[i] : 1; 
+    gran_start[i] = n_gran_total;
+    n_gran_total += n_granules[i];
+  }
 
-      // Get irradiation heating
-      tirr = surf.t_irr;
+  gran_phase = new float[n_gran_total];
+  for (int i = 0 ; i < n_lat ; i++) {
+    Random_stream row_random = random.substream(i);
+    for (int j = 0 ; j < n_granules[i] ; j++)
+      gran_phase[gran_start[i] + j] = row_random.uniform() * 2.0f * PI;
+  }
+
+  // Save the phase independent properties needed to calculate colours
+  granulation_amplitude = granulation_amplitude1;
+  granulation_period = granulation_period1;
+  cm = &cm1;
+  pool = &pool1;
+
+  temp_grid = new float[n_vert];
+  tirr_grid = new float[n_vert];
+  normal_grid = new Vec3[n_vert];
+
+  for (int index = 0 ; index < n_vert ; index++) {
+    // Get properties of the point on the surface
+    Surface_properties surf = surf_grid[index];
+    float temp = surf.temp;
+
+    // Invert coordinates and normals for companion
+    if (primary) {
+      surf.coords.x = -surf.coords.x;
+      surf.coords.y = -surf.coords.y;
+      surf.normal.x = -surf.normal.x;
+      surf.normal.y = -surf.normal.y;
+    }
+
+    // Enforce minimum temperature
+    temp = (temp > t_pole * t_min) ? temp : t_pole * t_min;
+
+    temp_grid[index] = temp;
+    tirr_grid[index] = surf.t_irr;
+    normal_grid[index] = surf.normal;
+
+    // Assign coordinates
+    if (primary) {
+      *(coord_grid[index])   = surf.coords.x + lobe.get_c_of_m();
+      *(coord_grid[index]+1) = surf.coords.y;
+      *(coord_grid[index]+2) = surf.coords.z;
+    } else {
+      *(coord_grid[index])   = surf.coords.x - lobe.get_c_of_m();
+      *(coord_grid[index]+1) = surf.coords.y;
+      *(coord_grid[index]+2) = surf.coords.z;
+    }
+  }
+
+  delete[] surf_grid;
+}
+
+/*
+  Release dynamically allocated memory
+*/
+Lobe_3d::~Lobe_3d()
+{
+  delete[] temp_grid;
+  delete[] tirr_grid;
+  delete[] normal_grid;
+  delete[] n_granules;
+  delete[] gran_start;
+  delete[] gran_phase;
+}
+
+/*
+  Calculate colours of the surface at one phase.  Each line of
+  latitude is independent, so they are shared between threads.
+*/
+void Lobe_3d::calc_colours(const int phase_index, const int offset)
+{
+  using Sci_const::PI;
+
+  const int k = phase_index;
+
+  pool->parallel_for(0, n_lat, [&](int i) {
+      const float *row_phase = gran_phase + gran_start[i];
+      const int n_gran = n_granules[i];
+
+      // Temperatures and viewing angles along the row
+      vector<float> row_temp(n_long), row_mu(n_long);
+
+      for (int j = 0 ; j < n_long ; j++) {
+	// Calculate angle of longitude
+	float phi = (2.0f * PI * j) / n_long;
+
+	// Determine index offset for this point
+	int index = i * n_long + j;
+
+	float temp = temp_grid[index];
+	float tirr = tirr_grid[index];
 
-      for (int k = 0 ; k < n_phase ; k++) {
 	// Apply granulation
-	float base_ind = phi / 2.0f / PI * n_granules; 
+	float base_ind = phi / 2.0f / PI * n_gran; 
 	int ind1 = static_cast<int> (base_ind);
-	int ind2 = (ind1 == n_granules-1) ? 0 : ind1+1;
+	int ind2 = (ind1 == n_gran-1) ? 0 : ind1+1;
 	
 	float int_frac = base_ind - floor(base_ind);
 	
 	float gran1 = 1.0f + granulation_amplitude * 
-	  sin(2.0f * PI * phase[k] * 10.0f + gran_phase[ind1]);
+	  sin(2.0f * PI * phase[k] * 10.0f + row_phase[ind1]);
 	
 	float gran2 = 1.0f + granulation_amplitude * 
-	  sin(2.0f * PI * phase[k] / granulation_period + gran_phase[ind2]);
+	  sin(2.0f * PI * phase[k] / granulation_period + row_phase[ind2]);
 	
-	temp1 = temp * ((1.0f - int_frac) * gran1 + int_frac * gran2);
+	float temp1 = temp * ((1.0f - int_frac) * gran1 + int_frac * gran2);
 	
 	// Combine intrinsic and irradiation temperatures
-	temp1 = sqrt(sqrt(temp1*temp1*temp1*temp1 + tirr*tirr*tirr*tirr));
-
-	// Determine phase dependent index for storing colour
-	int index1 = k * n_vert + index;
+	row_temp[j] = sqrt(sqrt(temp1*temp1*temp1*temp1 + 
+				tirr*tirr*tirr*tirr));
+	row_mu[j] = fabs(normal_grid[index] * eye_vec[k]);
+      }
 
-	// Calculate limb darkened colour on surface
-	float mu = fabs(surf.normal * eye_vec[k]);
- 	rgb = cm.get_rgb(temp1, mu);
+      // Determine phase dependent index for storing colours
+      int index1 = offset + i * n_long;
 
-	// Assign colours
+      // Assign limb darkened colours for the whole row
 #ifdef WIREFRAME
-	red_grid[index1] = 1.0f;
-	green_grid[index1] = 0.0f;
-	blue_grid[index1] = 0.0f;
+      for (int j = 0 ; j < n_long ; j++) {
+	red_grid[index1 + j] = 1.0f;
+	green_grid[index1 + j] = 0.0f;
+	blue_grid[index1 + j] = 0.0f;
+      }
 #else
-	red_grid[index1] = rgb.x;
-	green_grid[index1] = rgb.y;
-	blue_grid[index1] = rgb.z;
+      cm->get_rgb(n_long, &row_temp[0], &row_mu[0], red_grid + index1, 
+		  green_grid + index1, blue_grid + index1);
 #endif
-      }
+    });
+}
 
-      // Assign coordinates
-      if (primary) {
-	*(coord_grid[index])   = surf.coords.x + lobe.get_c_of_m();
-	*(coord_grid[index]+1) = surf.coords.y;
-	*(coord_grid[index]+2) = surf.coords.z;
-      } else {
-	*(coord_grid[index])   = surf.coords.x - lobe.get_c_of_m();
-	*(coord_grid[index]+1) = surf.coords.y;
-	*(coord_grid[index]+2) = surf.coords.z;
-      }
-    }
-    // Clean up
-    delete[] gran_phase;
-  }
+/*
+  Set the observer direction and granulation phase in the shader
+*/
+void Lobe_3d::begin_shading(const int phase_index)
+{
+  shader->set_eye(eye_vec[phase_index]);
+  shader->set_granulation(phase[phase_index], granulation_amplitude,
+			  granulation_period);
+}
+
+/*
+  Supply the temperatures, normal and granulation phases of a point to
+  the shader, interpolating granulation in the same way as
+  calc_colours
+*/
+void Lobe_3d::shade_vertex(const int coord_index)
+{
+  using Sci_const::PI;
+
+  const int i = coord_index / n_long;
+  const int j = coord_index - i * n_long;
+
+  const float *row_phase = gran_phase + gran_start[i];
+  const int n_gran = n_granules[i];
+
+  float phi = (2.0f * PI * j) / n_long;
+  float base_ind = phi / 2.0f / PI * n_gran; 
+  int ind1 = static_cast<int> (base_ind);
+  int ind2 = (ind1 == n_gran-1) ? 0 : ind1+1;
+  float int_frac = base_ind - floor(base_ind);
+
+  BB_shader::set_vertex(normal_grid[coord_index], temp_grid[coord_index],
+			tirr_grid[coord_index], row_phase[ind1], 
+			row_phase[ind2], int_frac);
 }
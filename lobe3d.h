@@ -34,6 +34,9 @@
 
 #include "bbcolormodel.h"
 #include "object3d.h"
+#include "random_stream.h"
+#include "roche_atlas.h"
+#include "thread_pool.h"
 
 #include "binsim_stdinc.h"
 
@@ -43,6 +46,28 @@ class Lobe_3d : public Object_3d {
   // Define the surface grid
   int n_steps, n_lat, n_long;
 
+  // Phase independent properties of each point on the surface
+  float *temp_grid, *tirr_grid;
+  Vec3 *normal_grid;
+
+  // Granulation phases for each line of latitude, stored one row
+  // after another
+  int *n_granules, *gran_start;
+  float *gran_phase;
+  float granulation_amplitude, granulation_period;
+
+  // Colour model and threads used to calculate colours
+  BB_color_model *cm;
+  Thread_pool *pool;
+
+  // Calculate colours at one phase
+  void calc_colours(const int phase_index, const int offset);
+
+  // Calculate colours with the black body shader, which also applies
+  // granulation
+  bool supports_shader() { return true; }
+  void begin_shading(const int phase_index);
+  void shade_vertex(const int coord_index);
 public:
   // Constructor
   Lobe_3d(const int n_steps1, const vector<float> phase, const float q, 
@@ -50,9 +75,13 @@ public:
 	  const float mass, const float t_pole, 
 	  const float t_min,
 	  const float l_irrad, const float disc_thick,
-	  const float granulation_amplitude, 
-	  const float granulation_period,
-	  const float fill, BB_color_model &cm, const bool primary);
+	  const float granulation_amplitude1, 
+	  const float granulation_period1,
+	  const float fill, BB_color_model &cm1, const bool primary,
+	  Thread_pool &pool1, const Random_stream &random, 
+	  const Roche_atlas *atlas = 0);
+
+  ~Lobe_3d();
 };
 
 /*****************************************************************************/
@@ -24,6 +24,11 @@
   along with this program.  If not, see <https://www.gnu.org/licenses/>. 
 */
 
+// Vertex buffer objects are part of OpenGL 1.5
+#ifndef NOGLEXT
+#define GL_GLEXT_PROTOTYPES
+#endif
+
 #include <iostream>
 
 #include <cmath>
@@ -44,8 +49,6 @@ extern Vertex_logger *vertex_logger;
 Object_3d::Object_3d(const vector<float> phase1, const int n_x1, 
 		     const int n_y1, const float inclination)
 {
-  using Sci_const::PI;
-
   // Set the object name
   object_name = "Object_3d";
 
@@ -54,24 +57,29 @@ Object_3d::Object_3d(const vector<float> phase1, const int n_x1,
   n_phase = phase.size();
 
   eye_vec = new Vec3[n_phase];
-
-  float inc_angle = -2.0f * PI * inclination / 360.f;
-  for (int k = 0 ; k < n_phase ; k++) {
-    float phase_angle = 2.0f * PI * phase[k];
-    eye_vec[k].x = cos(phase_angle) * sin(inc_angle);
-    eye_vec[k].y = -sin(phase_angle) * sin(inc_angle);
-    eye_vec[k].z = cos(inc_angle);
-  }
+  Object_3d::set_inclination(inclination);
 
   // Define grid size
   n_x = n_x1;
   n_y = n_y1;
   n_vert = n_x * n_y;
 
-  // Allocate grids of colours
-  red_grid = new GLfloat[n_phase*n_vert];
-  green_grid = new GLfloat[n_phase*n_vert];
-  blue_grid = new GLfloat[n_phase*n_vert];
+  // Grids of colours are allocated once the colour mode is known
+  red_grid = 0;
+  green_grid = 0;
+  blue_grid = 0;
+  on_demand = true;
+  colour_phase = -1;
+  shader = 0;
+
+  // Buffers are created when first drawn
+  use_vbo = false;
+  vertex_buffer = 0;
+  colour_buffer = 0;
+  index_buffer = 0;
+  n_index = 0;
+  colour_data = 0;
+  buffer_phase = -1;
 
   // Allocate grid of coordinates
   coord_grid = new GLfloat*[n_vert];
@@ -94,6 +102,171 @@ Object_3d::~Object_3d()
   // Deallocate grids of coordinates
   for (int i = 0; i < n_vert; i++) delete[] coord_grid[i];
   delete[] coord_grid;
+
+  // Release buffers
+  delete[] colour_data;
+#ifndef NOGLEXT
+  if (vertex_buffer) {
+    glDeleteBuffers(1, &vertex_buffer);
+    glDeleteBuffers(1, &colour_buffer);
+    glDeleteBuffers(1, &index_buffer);
+  }
+#endif
+}
+
+/*
+  Allocate colour grids to hold n points, replacing any existing ones
+*/
+void Object_3d::alloc_colours(const int n)
+{
+  delete[] red_grid;
+  delete[] green_grid;
+  delete[] blue_grid;
+
+  red_grid = new GLfloat[n];
+  green_grid = new GLfloat[n];
+  blue_grid = new GLfloat[n];
+}
+
+/*
+  Select the colour mode.  Precalculating colours for every phase
+  makes drawing fast, but memory grows with the number of phases.  In
+  on demand mode only one phase is held, and colours are recalculated
+  whenever a different phase is drawn.
+*/
+void Object_3d::init_colours(const bool on_demand1)
+{
+  on_demand = on_demand1;
+  colour_phase = -1;
+
+  if (on_demand) {
+    alloc_colours(n_vert);
+  } else {
+    alloc_colours(n_phase*n_vert);
+    for (int k = 0 ; k < n_phase ; k++) calc_colours(k, k*n_vert);
+  }
+}
+
+/*
+  Change the inclination of the binary, recalculating the direction to
+  the observer at each phase
+*/
+void Object_3d::set_inclination(const float inclination)
+{
+  view_inclination = inclination;
+  for (int k = 0 ; k < n_phase ; k++) calc_eye_vec(k);
+}
+
+/*
+  Calculate the direction to the observer at one phase
+*/
+void Object_3d::calc_eye_vec(const int phase_index)
+{
+  using Sci_const::PI;
+
+  const int k = phase_index;
+  float inc_angle = -2.0f * PI * view_inclination / 360.f;
+  float phase_angle = 2.0f * PI * phase[k];
+  eye_vec[k].x = cos(phase_angle) * sin(inc_angle);
+  eye_vec[k].y = -sin(phase_angle) * sin(inc_angle);
+  eye_vec[k].z = cos(inc_angle);
+}
+
+/*
+  Calculate colours again after the view or colour model has changed.
+  Colours calculated in advance are replaced, and those calculated on
+  demand or by a shader are marked out of date.
+*/
+void Object_3d::refresh_colours()
+{
+  colour_phase = -1;
+  buffer_phase = -1;
+
+  if (!on_demand && !shader)
+    for (int k = 0 ; k < n_phase ; k++) calc_colours(k, k*n_vert);
+}
+
+/*
+  Move one phase to a new value, so that phase need not be one of
+  those given when the object was created.  Its eye vector and
+  colours are calculated again.
+*/
+void Object_3d::set_phase(const int phase_index, const float phase1)
+{
+  const int k = phase_index;
+  phase[k] = phase1;
+  calc_eye_vec(k);
+
+  if (colour_phase == k) colour_phase = -1;
+  if (buffer_phase == k) buffer_phase = -1;
+
+  if (!on_demand && !shader) calc_colours(k, k*n_vert);
+}
+
+/*
+  Draw with a shader calculating colours on the GPU.  The colour grids
+  are not needed, so are released.
+*/
+bool Object_3d::use_shader(BB_shader *shader1)
+{
+  if (!supports_shader()) return false;
+
+  shader = shader1;
+  colour_phase = -1;
+
+  delete[] red_grid;
+  delete[] green_grid;
+  delete[] blue_grid;
+  red_grid = 0;
+  green_grid = 0;
+  blue_grid = 0;
+
+  return true;
+}
+
+/*
+  Select drawing from vertex buffers.  Not available if compiled with
+  -DNOGLEXT.
+*/
+void Object_3d::set_vertex_buffers(const bool use_vbo1)
+{
+#ifndef NOGLEXT
+  use_vbo = use_vbo1;
+#endif
+}
+
+/*
+  Make sure colours for a phase are ready to be drawn.  Objects can be
+  updated concurrently with each other, but not with drawing.
+*/
+void Object_3d::update_colours(const int phase_index)
+{
+  get_colour_offset(phase_index);
+}
+
+/*
+  Return the offset of colours for a phase in the colour grids,
+  calculating them first in on demand mode.  With a shader, only the
+  inputs to the shader are prepared.
+*/
+int Object_3d::get_colour_offset(const int phase_index)
+{
+  if (shader) {
+    if (colour_phase != phase_index) {
+      prepare_shading(phase_index);
+      colour_phase = phase_index;
+    }
+    return 0;
+  }
+
+  if (!on_demand) return phase_index * n_vert;
+
+  if (red_grid == 0) alloc_colours(n_vert);
+  if (colour_phase != phase_index) {
+    calc_colours(phase_index, 0);
+    colour_phase = phase_index;
+  }
+  return 0;
 }
 
 /*
@@ -105,7 +278,17 @@ void Object_3d::draw(const int phase_index)
   int index_i, index_ij, index;
   
   // More indices
-  const int base_index = phase_index * n_vert;
+  const int base_index = get_colour_offset(phase_index);
+
+  if (drawing_buffers()) {
+    draw_buffers(phase_index, base_index);
+    return;
+  }
+
+  if (shader) {
+    shader->enable();
+    begin_shading(phase_index);
+  }
 
   // Define object as column of triangle strips
   for (int i = 0 ; i < n_y-1 ; i++) {
@@ -137,6 +320,8 @@ void Object_3d::draw(const int phase_index)
 
     glEnd();
   }
+
+  if (shader) shader->disable();
 }
 
 /*
@@ -145,6 +330,12 @@ void Object_3d::draw(const int phase_index)
 */
 void Object_3d::draw_point(int coord_index, int color_index, int x, int y)
 {
+  if (shader) {
+    shade_vertex(coord_index);
+    glVertex3fv(coord_grid[coord_index]);
+    return;
+  }
+
   if (vertex_logger)
     vertex_logger->log_rgb(object_name, x, y,
 			   *(coord_grid[coord_index]), 
@@ -158,3 +349,124 @@ void Object_3d::draw_point(int coord_index, int color_index, int x, int y)
 	    blue_grid[color_index]);
   glVertex3fv(coord_grid[coord_index]);
 }
+
+/*
+  Buffers are used unless the shader or vertex logging need each point
+  to be sent separately
+*/
+bool Object_3d::drawing_buffers()
+{
+  return use_vbo && shader == 0 && vertex_logger == 0;
+}
+
+/*
+  Create the buffers.  The coordinates and the order in which they are
+  drawn do not change, so are uploaded once.  The rows of the grid are
+  drawn as a single triangle strip, joined by repeating the last point
+  of each row twice, which adds degenerate triangles that are not
+  drawn and keeps the winding of the next row the same.
+*/
+void Object_3d::init_buffers()
+{
+#ifndef NOGLEXT
+  // Copy coordinates into a single array
+  GLfloat *coord_data = new GLfloat[3*n_vert];
+  for (int i = 0 ; i < n_vert ; i++) {
+    coord_data[3*i] = *(coord_grid[i]);
+    coord_data[3*i+1] = *(coord_grid[i]+1);
+    coord_data[3*i+2] = *(coord_grid[i]+2);
+  }
+
+  // List points in the same order as draw
+  vector<GLuint> index;
+  for (int i = 0 ; i < n_y-1 ; i++) {
+    int index_i = i * n_x;
+
+    for (int j = 0 ; j < n_x ; j++) {
+      index.push_back(index_i + j);
+      index.push_back(index_i + j + n_x);
+    }
+    index.push_back(index_i);
+    index.push_back(index_i + n_x);
+
+    // Join to next row
+    if (i < n_y-2) {
+      index.push_back(index_i + n_x);
+      index.push_back(index_i + n_x);
+    }
+  }
+  n_index = index.size();
+
+  glGenBuffers(1, &vertex_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, 3*n_vert*sizeof(GLfloat), coord_data, 
+	       GL_STATIC_DRAW);
+
+  glGenBuffers(1, &colour_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, colour_buffer);
+  glBufferData(GL_ARRAY_BUFFER, 4*n_vert*sizeof(GLfloat), 0, 
+	       GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glGenBuffers(1, &index_buffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, n_index*sizeof(GLuint), &index[0],
+	       GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  delete[] coord_data;
+
+  colour_data = new GLfloat[4*n_vert];
+  buffer_phase = -1;
+#endif
+}
+
+/*
+  Copy colours for a phase into colour_data.  Opaque objects have unit
+  alpha.
+*/
+void Object_3d::fill_colour_buffer(const int base_index)
+{
+  for (int i = 0 ; i < n_vert ; i++) {
+    colour_data[4*i] = red_grid[base_index + i];
+    colour_data[4*i+1] = green_grid[base_index + i];
+    colour_data[4*i+2] = blue_grid[base_index + i];
+    colour_data[4*i+3] = 1.0f;
+  }
+}
+
+/*
+  Draw the object with one call, uploading colours first if the phase
+  has changed
+*/
+void Object_3d::draw_buffers(const int phase_index, const int base_index)
+{
+#ifndef NOGLEXT
+  if (vertex_buffer == 0) init_buffers();
+
+  if (buffer_phase != phase_index) {
+    fill_colour_buffer(base_index);
+    glBindBuffer(GL_ARRAY_BUFFER, colour_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, 4*n_vert*sizeof(GLfloat), 
+		    colour_data);
+    buffer_phase = phase_index;
+  }
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+  glVertexPointer(3, GL_FLOAT, 0, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, colour_buffer);
+  glColorPointer(4, GL_FLOAT, 0, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+
+  glDrawElements(GL_TRIANGLE_STRIP, n_index, GL_UNSIGNED_INT, 0);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+#endif
+}
@@ -39,6 +39,7 @@
 	#include <GL/glut.h>
 #endif
 
+#include "bbshader.h"
 #include "mathvec.h"
 
 #include "binsim_stdinc.h"
@@ -61,14 +62,75 @@ protected:
 
   Vec3* eye_vec;
 
+  // Inclination the eye vectors are calculated for
+  float view_inclination;
+
+  // Calculate the eye vector at one phase
+  void calc_eye_vec(const int phase_index);
+
   // Define the surface grid
   int n_x, n_y, n_vert;
 
   GLfloat *red_grid, *green_grid, *blue_grid;
   GLfloat **coord_grid;
 
+  // If set, colours are held for a single phase and calculated as
+  // each phase is drawn, rather than for every phase in advance
+  bool on_demand;
+
+  // Phase whose colours are currently held in on demand mode
+  int colour_phase;
+
+  // If set, colours are calculated on the GPU by this shader
+  BB_shader *shader;
+
+  // If set, the grid is drawn from buffers held by OpenGL rather than
+  // sent point by point
+  bool use_vbo;
+
+  // Buffers of coordinates, colours and indices of the strips, and
+  // colours in the same layout before upload
+  GLuint vertex_buffer, colour_buffer, index_buffer;
+  int n_index;
+  GLfloat *colour_data;
+
+  // Phase whose colours are currently in the colour buffer
+  int buffer_phase;
+
+  // Create buffers and upload the coordinates and strip indices
+  void init_buffers();
+
+  // Copy colours for a phase into colour_data as RGBA
+  virtual void fill_colour_buffer(const int base_index);
+
+  // Draw the object from the buffers
+  void draw_buffers(const int phase_index, const int base_index);
+
+  // Should the buffers be used for this draw?
+  bool drawing_buffers();
+
+  // Allocate colour grids to hold n points
+  virtual void alloc_colours(const int n);
+
+  // Calculate colours of every point at one phase, storing them in
+  // the colour grids starting at the given offset
+  virtual void calc_colours(const int phase_index, const int offset) = 0;
+
+  // Offset of colours for a phase in the colour grids, calculating
+  // them first if necessary
+  int get_colour_offset(const int phase_index);
+
   // Issue OpenGL commands to draw a point
   virtual void draw_point(int coord_index, int color_index, int x, int y);
+
+  // Objects that can be drawn with the black body shader override
+  // these to say so, to prepare any phase dependent inputs to the
+  // shader, to set it up for a phase and to supply its inputs for
+  // each vertex
+  virtual bool supports_shader() { return false; }
+  virtual void prepare_shading(const int phase_index) { }
+  virtual void begin_shading(const int phase_index) { }
+  virtual void shade_vertex(const int coord_index) { }
 public:
   // Constructor and destructor
   Object_3d(const vector<float> phase1, const int n_x1, const int n_y1, 
@@ -76,6 +138,32 @@ public:
 
   virtual ~Object_3d();
 
+  // Choose whether to calculate colours for all phases now, or for
+  // each phase as it is drawn
+  void init_colours(const bool on_demand1);
+
+  // Change the inclination of the binary, recalculating the
+  // directions to the observer.  Colours must then be refreshed.
+  virtual void set_inclination(const float inclination);
+
+  // Calculate colours again after the view or colour model has
+  // changed, leaving the geometry as it is
+  void refresh_colours();
+
+  // Move one phase to a new value, recalculating its eye vector and
+  // colours
+  void set_phase(const int phase_index, const float phase1);
+
+  // Calculate colours with a shader instead, if this object supports
+  // it.  Returns true if the shader will be used.
+  bool use_shader(BB_shader *shader1);
+
+  // Choose whether to draw from buffers held by OpenGL
+  void set_vertex_buffers(const bool use_vbo1);
+
+  // Make sure colours for a phase are ready to be drawn
+  void update_colours(const int phase_index);
+
   // Generate the OpenGL commands to draw the object
   virtual void draw(int phase_index);
 };
@@ -24,8 +24,13 @@
   along with this program.  If not, see <https://www.gnu.org/licenses/>. 
 */
 
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <GL/glut.h>
 #include <GL/osmesa.h>
@@ -34,10 +39,13 @@
 #include "errmsg.h"
 #include "keyword.h"
 #include "keyword_translator.h"
+#include "param_sweep.h"
+#include "stream.h"
 
 #include "binsim_stdinc.h"
 
 using std::cout;
+using std::vector;
 
 /*****************************************************************************/
 
@@ -56,127 +64,305 @@ void print_default_key_msg(const string key, const string def)
 
 /*****************************************************************************/
 
+// Allocate an image buffer and create an image writer for it
+Image_writer *create_buffer(const int width, const int height, void **buffer)
+{
+  // OSMesa16 interface
+#ifdef BIGBUFFER
+  *buffer = malloc(width * height * 4 * sizeof(GLushort));
+  return new OS16_image_writer(width, height, 
+			       static_cast<GLushort *> (*buffer));
+#else
+  *buffer = malloc(width * height * 4 * sizeof(GLubyte));
+  return new OS_image_writer(width, height, 
+			     static_cast<GLubyte *> (*buffer));
+#endif
+}
+
+// Create an RGBA-mode context drawing into an image buffer and make it
+// current
+OSMesaContext create_context(void *buffer, const int width, const int height)
+{
+  OSMesaContext ctx;
+
+  // OSMesa16 interface
+#ifdef BIGBUFFER
+  ctx = OSMesaCreateContextExt(GL_RGBA, 16, 0, 16, NULL);
+  OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_SHORT, width, height);
+#else    
+  ctx = OSMesaCreateContext(GL_RGBA, NULL);
+  OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, width, height);
+#endif
+
+  return ctx;
+}
+
+/*****************************************************************************/
+
+// Animation frames drawn by worker threads, waiting to be saved in
+// order
+struct Frame_reorder {
+  // Next phase to be drawn and next to be saved
+  std::atomic<int> next_draw;
+  int next_save;
+
+  // Frames drawn but not yet saved, by phase
+  std::map<int, unsigned char *> waiting;
+
+  // Synchronisation of the above, apart from next_draw
+  std::mutex lock;
+};
+
+// Main loop of a worker thread.  Each thread draws phases taken in
+// turn from a shared counter with its own context and view of the
+// model, and saves any frames that are next in order.
+void draw_frames(Bin_sim *bin_sim, Image_writer *writer, 
+		 Frame_reorder *frames, const int width, const int height)
+{
+  void *buffer;
+  Image_writer *context_writer = create_buffer(width, height, &buffer);
+  OSMesaContext ctx = create_context(buffer, width, height);
+
+  Bin_sim *view = new Bin_sim(*bin_sim, context_writer);
+  view->gl_setup_context();
+
+  const int n_phase = bin_sim->phase.size();
+  while (true) {
+    // Take storage before taking a phase, so the earliest phase not
+    // yet saved is never left waiting for storage
+    unsigned char *pixels = writer->take_frame();
+    const int phase = frames->next_draw++;
+    if (phase >= n_phase) {
+      writer->release_frame(pixels);
+      break;
+    }
+
+    view->draw_phase(phase);
+    glFinish();
+    context_writer->copy_frame(pixels);
+
+    // Save this frame and any after it that are ready
+    std::unique_lock<std::mutex> guard(frames->lock);
+    frames->waiting[phase] = pixels;
+    while (frames->waiting.count(frames->next_save)) {
+      bin_sim->save_frame(frames->waiting[frames->next_save], 
+			  frames->next_save);
+      frames->waiting.erase(frames->next_save);
+      frames->next_save++;
+    }
+  }
+
+  // The view releases its resources in its own context
+  delete view;
+  OSMesaDestroyContext(ctx);
+  delete context_writer;
+  free(buffer);
+}
+
+/*****************************************************************************/
+
 int main(int argc, char** argv)
 {
   // Object encapsulating information about the model
-  Bin_sim *bin_sim;
+  Bin_sim *bin_sim = 0;
 
-  // Parameter file
-  string filename;
+  // Parameter file and sweep file
+  string filename, sweep_file;
 
   // Offscreen dimensions
   int width, height;
 
   // RGBA-mode context
-  OSMesaContext ctx;
+  OSMesaContext ctx = 0;
 
   // Image buffer
   void *buffer; 
 
   // Image writer
-  Image_writer *writer;
+  Image_writer *writer = 0;
 
   // Animation flag
   bool anim;
 
+  // Number of threads drawing animation frames
+  int n_threads;
+
+  // Slice of animation frames to draw, and whether to skip frames
+  // already saved
+  string frame_slice;
+  bool resume = false;
+
+  // Sweep over a grid of parameters, rendering each point with the
+  // same context and image buffer.  Stream trajectories are shared by
+  // every point, and when only the view changes from one point to the
+  // next the model is kept and only its colours are recalculated.
+  Param_sweep *sweep = 0;
+  int n_point = 1;
+  Stream_cache streams;
+  bool reuse = false;
+
   // Basic OpenGL initialisation
   glutInit(&argc, argv);
 
-  // Get input file names
-  if (argc == 2)
-    filename = argv[1];
-  else {
-    cout << "Usage: osbinsim paramfile\n";
+  // Get options and input file names
+  for (int i = 1 ; i < argc ; i++) {
+    string arg = argv[i];
+    if (arg == "-frames" && i+1 < argc) frame_slice = argv[++i];
+    else if (arg == "-resume") resume = true;
+    else if (arg == "-sweep" && i+1 < argc) sweep_file = argv[++i];
+    else if (filename == "" && arg[0] != '-') filename = arg;
+    else {
+      filename = "";
+      break;
+    }
+  }
+  if (filename == "") {
+    cout << "Usage: osbinsim [-frames start:end[:stride]] [-resume] "
+	 << "[-sweep sweepfile] paramfile\n";
     exit(1);
   }
 
-  try {
-    // Read parameter file
-    cout << "Parsing parameter file...\n";
-    Key_list params(filename);
-
-    // Translate parameter file
-    apply_keyword_translation(&params);
-
-    // Get animation switch silently - default message will be
-    // triggered by Bin_sim
-    try { anim = params.get_bool("ANIM"); }
-    catch (Key_list::Key_not_found_exception) {
-      anim = false;
+  // Keep standard output free for video if it is streamed there
+  if (Bin_sim::video_to_stdout(filename)) cout.rdbuf(std::cerr.rdbuf());
+
+  for (int point = 0 ; point < n_point ; point++) {
+    try {
+      // Read sweep file
+      if (sweep_file != "" && point == 0) {
+	cout << "Parsing sweep file...\n";
+	sweep = new Param_sweep(sweep_file);
+	n_point = sweep->size();
+      }
+
+      // Read parameter file
+      cout << "Parsing parameter file...\n";
+      Key_list params(filename);
+
+      // Translate parameter file
+      apply_keyword_translation(&params);
+
+      // Command line options override the parameter file
+      if (frame_slice != "") params.add_item("FRAMES", frame_slice);
+      if (resume) params.add_item("RESUME", "True");
+
+      // Add the parameters of this point of the sweep
+      if (sweep) {
+	sweep->apply(point, params);
+	cout << "Sweep point " << point + 1 << " of " << n_point << ": "
+	     << params.get_value("IMAGE_FILE") << "\n";
+      }
+
+      // Get animation switch silently - default message will be
+      // triggered by Bin_sim
+      try { anim = params.get_bool("ANIM"); }
+      catch (Key_list::Key_not_found_exception) {
+	anim = false;
+      }
+      if (anim && sweep)
+	throw Key_list::Value_out_of_range_exception("ANIM", 
+						     "False when sweeping");
+
+      // Image width - must be positive
+      width = params.get_int("WIDTH"); 
+      if (width < 1) 
+	throw Key_list::Value_out_of_range_exception("WIDTH", ">= 1");
+
+      // Image height - must be positive
+      height = params.get_int("HEIGHT");
+      if (height < 1) 
+	throw Key_list::Value_out_of_range_exception("HEIGHT", ">= 1");
+
+      // Get tile size silently - default message will be triggered by
+      // Bin_sim.  When rendering in tiles the buffer only holds one
+      // tile.
+      int tile_size;
+      try { tile_size = params.get_int("TILE_SIZE"); }
+      catch (Key_list::Key_not_found_exception) {
+	tile_size = 0;
+      }
+      if (tile_size > 0) width = height = tile_size;
+
+      // Number of threads drawing animation frames, each with its own
+      // OpenGL context - default 1, must be >= 1
+      try { n_threads = params.get_int("THREADS"); }
+      catch (Key_list::Key_not_found_exception) {
+	n_threads = 1;
+	print_default_key_msg("THREADS", "1");
+      }
+      if (n_threads < 1) 
+	throw Key_list::Value_out_of_range_exception("THREADS", ">= 1");
+
+      // Allocate the image buffer and create image writer
+      if (point == 0) writer = create_buffer(width, height, &buffer);
+
+      // Create renderer, unless the previous point's can be reused
+      reuse = (point > 0 && 
+	       bin_sim->update_view(params, sweep->changed_keys(point)));
+      if (point == 0) Bin_sim::start_vertex_log(params);
+      if (!reuse) {
+	delete bin_sim;
+	bin_sim = new Bin_sim(params, writer, &streams);
+      }
+    } 
+    catch (Key_list::File_access_exception e) {
+      terminate("File access error: " + e);
+    } 
+    catch (Key_list::File_format_exception e) {
+      terminate("File format error: " + e);
+    } 
+    catch (Key_list::Key_not_found_exception e) {
+      terminate("Key not found: " + e + " - No default value!");
+    } 
+    catch (Key_list::Value_out_of_range_exception e) {
+      terminate("   Value out of range: " + e.keyword + 
+		" - Must be " + e.value);
     }
 
-     // Image width - must be positive
-    width = params.get_int("WIDTH"); 
-    if (width < 1) 
-      throw Key_list::Value_out_of_range_exception("WIDTH", ">= 1");
+    // Nothing to draw if every frame has already been saved
+    if (anim && bin_sim->phase.empty()) return 0;
 
-    // Image height - must be positive
-    height = params.get_int("HEIGHT");
-    if (height < 1) 
-      throw Key_list::Value_out_of_range_exception("HEIGHT", ">= 1");
-
-    // OSMesa16 interface
-#ifdef BIGBUFFER
-    // Allocate the image buffer
-    buffer = malloc(width * height * 4 * sizeof(GLushort));
-    
-    // Create image writer
-    writer = new OS16_image_writer(width, height, 
-				   static_cast<GLushort *> (buffer));
-#else
-    // Allocate the image buffer
-    buffer = malloc(width * height * 4 * sizeof(GLubyte));
-    
-    // Create image writer
-    writer = new OS_image_writer(width, height, 
-				 static_cast<GLubyte *> (buffer));
-#endif
+    // Create an RGBA-mode context bound to the buffer
+    if (point == 0) ctx = create_context(buffer, width, height);
 
-   // Create renderer
-    bin_sim = new Bin_sim(params, writer);
-  } 
-  catch (Key_list::File_access_exception e) {
-    terminate("File access error: " + e);
-  } 
-  catch (Key_list::File_format_exception e) {
-    terminate("File format error: " + e);
-  } 
-  catch (Key_list::Key_not_found_exception e) {
-    terminate("Key not found: " + e + " - No default value!");
-  } 
-  catch (Key_list::Value_out_of_range_exception e) {
-    terminate("   Value out of range: " + e.keyword + 
-              " - Must be " + e.value);
-  }
-
-  // Main OpenGL initialisation
-  cout << "Initialising renderer...\n";
+    // Main OpenGL initialisation
+    if (!reuse) {
+      cout << "Initialising renderer...\n";
+      bin_sim->gl_setup(false);
+    }
 
-  // OSMesa16 interface
-#ifdef BIGBUFFER
-  // Create an RGBA-mode context
-  ctx = OSMesaCreateContextExt(GL_RGBA, 16, 0, 16, NULL);
-  
-  // Bind the buffer to the context and make it current
-  OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_SHORT, width, height);
-#else    
-  // Create an RGBA-mode context
-  ctx = OSMesaCreateContext(GL_RGBA, NULL);
+    // Check frames can be drawn by several threads at once
+    if (anim && n_threads > 1 && !bin_sim->prepare_concurrent_drawing()) {
+      cout << "   Frames can only be drawn by several threads when saving "
+	   << "an animation\n   without Colour_On_Demand, Shaders, Tile_Size "
+	   << "or Vertex_Log - using 1\n";
+      n_threads = 1;
+    }
   
-  // Bind the buffer to the context and make it current
-  OSMesaMakeCurrent(ctx, buffer, GL_UNSIGNED_BYTE, width, height);
-#endif
+    // Begin rendering
+    cout << "Rendering...\n";
+    if (anim && n_threads > 1) {
+      // Each thread holds a frame while drawing it
+      writer->reserve_frames(n_threads);
+
+      Frame_reorder frames;
+      frames.next_draw = 0;
+      frames.next_save = 0;
+
+      vector<std::thread> workers;
+      for (int i = 0 ; i < n_threads ; i++)
+	workers.push_back(std::thread(draw_frames, bin_sim, writer, &frames,
+				      width, height));
+      for (int i = 0 ; i < n_threads ; i++) workers[i].join();
+    } else if (anim) { 
+      while (!bin_sim->last_frame()) {
+	bin_sim->next_frame();
+	bin_sim->draw(false);
+      } 
+    } else bin_sim->draw(false);
+  }
 
-  bin_sim->gl_setup(false);
-  
-  // Begin rendering
-  cout << "Rendering...\n";
-  if (anim) { 
-    while (!bin_sim->last_frame()) {
-      bin_sim->next_frame();
-      bin_sim->draw(false);
-    } 
-  } else bin_sim->draw(false);
+  // Release the model while its context is current
+  delete bin_sim;
   
   // Free the image buffer
   free(buffer);
@@ -0,0 +1,159 @@
+/*
+  Class to step through a grid of parameter values
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+
+#include "errmsg.h"
+#include "keyword_translator.h"
+#include "param_sweep.h"
+#include "stringutil.h"
+
+/*****************************************************************************/
+
+/*
+  Constructor - read the sweep file and list the values of each swept
+  keyword
+*/
+Param_sweep::Param_sweep(const string filename)
+{
+  Key_list params(filename);
+  apply_keyword_translation(&params);
+
+  n_point = 1;
+
+  vector<string> file_keys = params.get_keys();
+  for (unsigned i = 0 ; i < file_keys.size() ; i++) {
+    string key = file_keys[i];
+    string value = params.get_value(key);
+
+    // The image buffer and its use are fixed for the whole sweep
+    if (key == "WIDTH" || key == "HEIGHT" || key == "TILE_SIZE" ||
+	key == "ANIM" || key == "THREADS")
+      throw Key_list::Value_out_of_range_exception(key,
+			   "set in the parameter file, not the sweep file");
+
+    // Anything other than a range, e.g. a filename, is a fixed value
+    vector<string> range = String_util::split_string(value, ':', true);
+    if (range.size() != 3) {
+      fixed_keys.push_back(key);
+      fixed_values.push_back(value);
+      continue;
+    }
+
+    // Range of values - start:end:step, with end included
+    float start, end, step;
+    char tail;
+    if (sscanf(range[0].c_str(), "%f%c", &start, &tail) != 1 ||
+	sscanf(range[1].c_str(), "%f%c", &end, &tail) != 1 ||
+	sscanf(range[2].c_str(), "%f%c", &step, &tail) != 1)
+      throw Key_list::File_format_exception(key + " = " + value);
+
+    if (end < start || step <= 0.0f)
+      throw Key_list::Value_out_of_range_exception(key,
+		   "start:end:step with end >= start and step > 0.0");
+
+    // Number of values, allowing for rounding as for phases
+    int n = static_cast<int> ((end - start) / step + 0.5f) + 1;
+
+    vector<string> key_values;
+    for (int j = 0 ; j < n ; j++) {
+      char buffer[32];
+      sprintf(buffer, "%g", start + j * step);
+      key_values.push_back(buffer);
+    }
+
+    keys.push_back(key);
+    values.push_back(key_values);
+    n_point *= n;
+  }
+}
+
+/*
+  Add the keywords of one point of the sweep to a parameter list.
+  They are added at the end, so override the same keywords given
+  earlier.  Every point is saved, and each swept keyword that takes
+  more than one value must appear in the image filename template, so
+  that every point is saved to a different file.
+*/
+void Param_sweep::apply(const int point, Key_list &params)
+{
+  params.add_item("SAVE", "True");
+  for (unsigned i = 0 ; i < fixed_keys.size() ; i++)
+    params.add_item(fixed_keys[i], fixed_values[i]);
+
+  // Image filename template, with the same default as Bin_sim
+  string filename;
+  try { filename = params.get_value("IMAGE_FILE"); }
+  catch (Key_list::Key_not_found_exception) {
+#ifndef NOJPEG
+    filename = "binsim.jpg";
+    print_default_key_msg("IMAGE_FILE", "binsim.jpg");
+#else
+    filename = "binsim.ppm";
+    print_default_key_msg("IMAGE_FILE", "binsim.ppm");
+#endif
+  }
+  String_util::strip_whitespace(filename);
+
+  // Decompose the point number with the last keyword changing fastest
+  int index = point;
+  for (int i = keys.size() - 1 ; i >= 0 ; i--) {
+    const int n = values[i].size();
+    const string value = values[i][index % n];
+    index /= n;
+
+    params.add_item(keys[i], value);
+
+    // Fill in the template, matching keywords in any case
+    bool found = String_util::replace_field(filename, keys[i], value);
+    if (!found && n > 1)
+      throw Key_list::Value_out_of_range_exception("IMAGE_FILE",
+		   "a template including {" + keys[i] + "}");
+  }
+
+  params.add_item("IMAGE_FILE", filename);
+}
+
+/*
+  List the keywords whose values differ between one point of the sweep
+  and the previous one.  The image filename differs at every point.
+*/
+vector<string> Param_sweep::changed_keys(const int point)
+{
+  vector<string> changed;
+  changed.push_back("IMAGE_FILE");
+
+  int index = point, previous = point - 1;
+  for (int i = keys.size() - 1 ; i >= 0 ; i--) {
+    const int n = values[i].size();
+    if (index % n != previous % n) changed.push_back(keys[i]);
+    index /= n;
+    previous /= n;
+  }
+
+  return changed;
+}
+
+/*****************************************************************************/
@@ -0,0 +1,76 @@
+/*
+  Class to step through a grid of parameter values
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _PARAM_SWEEP_H
+#define _PARAM_SWEEP_H
+
+#include <string>
+#include <vector>
+
+#include "keyword.h"
+
+#include "binsim_stdinc.h"
+
+using std::string;
+using std::vector;
+
+/*****************************************************************************/
+
+/*
+  A sweep file holds keywords to be added to a parameter file.  Those
+  with values of the form start:end:step are swept over every value
+  from start to end, and the sweep covers every combination of these,
+  with the first keyword changing slowest.  Other keywords are the same
+  for every point.  Image_File is a template, in which {Keyword} is
+  replaced by the value of a swept keyword.
+*/
+class Param_sweep {
+  // Swept keywords and the values taken by each
+  vector<string> keys;
+  vector<vector<string> > values;
+
+  // Keywords with the same value at every point
+  vector<string> fixed_keys, fixed_values;
+
+  // Total number of points
+  int n_point;
+public:
+  // Constructor
+  Param_sweep(const string filename);
+
+  // Number of points in the sweep
+  int size() { return n_point; }
+
+  // Add the keywords of one point of the sweep to a parameter list,
+  // including the image filename made from the template
+  void apply(const int point, Key_list &params);
+
+  // Keywords whose values differ from those of the previous point
+  vector<string> changed_keys(const int point);
+};
+
+/*****************************************************************************/
+
+#endif
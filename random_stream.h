@@ -0,0 +1,75 @@
+/*
+  Class to generate an independent, reproducible random number sequence
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _RANDOM_STREAM_H
+#define _RANDOM_STREAM_H
+
+#include "binsim_stdinc.h"
+
+/*****************************************************************************/
+
+/*
+  Counter based random number generator.  Each object of a model has
+  its own stream, identified by the model seed and an object number,
+  and each row of an object draws from a substream keyed by the row
+  number.  The n'th value drawn from a substream depends only on
+  (seed, object, row, n), so results do not depend on the order in
+  which objects or rows are built, nor on the number of threads.
+  Uses the SplitMix64 generator.
+*/
+class Random_stream {
+  // Generator state
+  unsigned long long state;
+
+  // Weyl sequence increment
+  static const unsigned long long GAMMA = 0x9E3779B97F4A7C15ULL;
+
+  // Scramble a 64 bit value
+  static unsigned long long mix(unsigned long long z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+public:
+  // Constructor, for the stream with the given key within a seed
+  Random_stream(const unsigned long long seed, 
+		const unsigned long long key = 0) 
+    : state(mix(seed + mix(key + GAMMA))) { }
+
+  // Independent stream keyed by, for example, a row number
+  Random_stream substream(const unsigned long long key) const {
+    return Random_stream(state, key);
+  }
+
+  // Next raw 64 bit value
+  unsigned long long next() { return mix(state += GAMMA); }
+
+  // Uniform deviate in the range 0-1
+  float uniform() { return (next() >> 40) * (1.0f / 16777216.0f); }
+};
+
+/*****************************************************************************/
+
+#endif
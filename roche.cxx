@@ -24,6 +24,7 @@
 */
 
 #include "roche.h"
+#include "roche_atlas.h"
 
 /*****************************************************************************/
 
@@ -163,6 +164,52 @@ float Roche_lobe::get_pot_cartesian(const float x, const float y,
   return get_pot(r, l, nu);
 }
 
+/*
+  Return the gradient of the potential at an arbitary point
+*/
+Vec3 Roche_lobe::get_pot_gradient(const float x, const float y, 
+				  const float z)
+{
+  // Distances from this star and the companion
+  const float r  = sqrt(x*x + y*y + z*z);
+  const float r2 = sqrt((x-1.0f)*(x-1.0f) + y*y + z*z);
+
+  const float r_3  = 1.0f / (r * r * r);
+  const float r2_3 = q_inv / (r2 * r2 * r2);
+
+  // Differentiate the three terms of the potential
+  const float gx = -x*r_3 - (x-1.0f)*r2_3 - q_inv + (q_inv + 1.0f) * x;
+  const float gy = -y*r_3 - y*r2_3 + (q_inv + 1.0f) * y;
+  const float gz = -z*r_3 - z*r2_3;
+
+  return Vec3(gx, gy, gz);
+}
+
+/*
+  Return the potential and its first and second derivatives along the
+  radial direction given by l and nu
+*/
+void Roche_lobe::get_pot_radial(const double r, const float l, 
+				const float nu, double &pot, 
+				double &dpot_dr, double &d2pot_dr2)
+{
+  // Distance from the companion
+  const double d2 = 1.0 - 2.0*l*r + r*r;
+  const double d  = sqrt(d2);
+  const double d_3 = 1.0 / (d2 * d);
+
+  const double sin2 = 1.0 - nu*nu;
+
+  pot = 1.0 / r + q_inv * (1.0 / d - l*r) + (q_inv + 1.0) / 2.0 * r*r * sin2;
+
+  dpot_dr = -1.0 / (r*r) + q_inv * (-(r - l) * d_3 - l) + 
+    (q_inv + 1.0) * r * sin2;
+
+  d2pot_dr2 = 2.0 / (r*r*r) + 
+    q_inv * (3.0 * (r - l)*(r - l) * d_3 / d2 - d_3) + 
+    (q_inv + 1.0) * sin2;
+}
+
 /*
   Return the potential at the lobe surface
 */
@@ -217,28 +264,57 @@ float Roche_lobe::get_polar_grav()
   return g_pole;
 }
 
+/*
+  Calculate every property that is otherwise cached on first use.
+  Afterwards the getters only read members, so several threads can
+  use the lobe at once.
+*/
+void Roche_lobe::prepare()
+{
+  get_separation();
+  get_c_of_m();
+  get_l1();
+  get_eggleton();
+  get_inverse_eggleton();
+  get_surf_pot();
+  get_polar_rad();
+  get_polar_grav();
+}
+
 /*
   Return the radius at in an arbitary direction
 */
 float Roche_lobe::get_rad(const float l, const float nu) 
 {
+  const int max_iter = 50;
+
   // Bracket radius point with the polar radius and the L1 point
-  float r0 = get_polar_rad();
-  float r2 = get_l1();
-	
-  float r1 = (r0 + r2) / 2.0f;
-  float dr = r2 - r0;
-	
-  // Use binary search to locate point where potential equals the
-  // surface potential
-  while (dr > TOL) {
-    if (get_pot(r1, l, nu) > get_surf_pot())
+  double r0 = get_polar_rad();
+  double r2 = get_l1();
+  double r1 = (r0 + r2) / 2.0;
+
+  const double pot_surf = get_surf_pot();
+
+  // Use Halley's method to locate point where potential equals the
+  // surface potential, falling back on bisection whenever a step
+  // would leave the bracket
+  for (int i = 0 ; i < max_iter && r2 - r0 > TOL ; i++) {
+    double pot, dpot, d2pot;
+    get_pot_radial(r1, l, nu, pot, dpot, d2pot);
+
+    const double f = pot - pot_surf;
+    if (f > 0.0)
       r0 = r1;
     else
       r2 = r1;
-	    
-    r1 = (r0 + r2) / 2.0f;
-    dr = r2 - r0;
+
+    const double denom = 2.0 * dpot * dpot - f * d2pot;
+    double r_new = (denom != 0.0) ? r1 - 2.0 * f * dpot / denom : r1;
+    if (!(r_new > r0 && r_new < r2)) r_new = (r0 + r2) / 2.0;
+
+    const double step = fabs(r_new - r1);
+    r1 = r_new;
+    if (step < 0.01 * TOL) break;
   }
 	
   return r1;
@@ -250,21 +326,8 @@ float Roche_lobe::get_rad(const float l, const float nu)
 float Roche_lobe::get_grav(const float r, const float l, 
 			   const float mu, const float nu) 
 {
-  // Convert the point to Cartesian coordinates
-  const float x = r * l;
-  const float y = r * mu;
-  const float z = r * nu;
-
-  // Evaluate the Cartesian partial derivatives of the potential
-  const float gx = (get_pot_cartesian(x + DXYZ, y, z) - 
-	      get_pot_cartesian(x - DXYZ, y, z)) / DXYZ;
-  const float gy = (get_pot_cartesian(x, y + DXYZ, z) - 
-	      get_pot_cartesian(x, y - DXYZ, z)) / DXYZ;
-  const float gz = (get_pot_cartesian(x, y, z + DXYZ) - 
-	      get_pot_cartesian(x, y, z - DXYZ)) / DXYZ;
-
-  // Return the gravity
-  return sqrt(gx*gx + gy*gy + gz*gz);
+  // Return the magnitude of the potential gradient
+  return get_pot_gradient(r * l, r * mu, r * nu).mod();
 }
 
 /*
@@ -273,20 +336,7 @@ float Roche_lobe::get_grav(const float r, const float l,
 Vec3 Roche_lobe::get_normal(const float r, const float l, 
 			    const float mu, const float nu) 
 {
-  // Convert the point to Cartesian coordinates
-  const float x = r * l;
-  const float y = r * mu;
-  const float z = r * nu;
-
-  // Evaluate the Cartesian partial derivatives of the potential
-  const float gx = (get_pot_cartesian(x + DXYZ, y, z) - 
-	      get_pot_cartesian(x - DXYZ, y, z)) / DXYZ;
-  const float gy = (get_pot_cartesian(x, y + DXYZ, z) - 
-	      get_pot_cartesian(x, y - DXYZ, z)) / DXYZ;
-  const float gz = (get_pot_cartesian(x, y, z + DXYZ) - 
-	      get_pot_cartesian(x, y, z - DXYZ)) / DXYZ;
-
-  Vec3 grad(-gx,-gz,-gy);
+  Vec3 grad = -1.0f * get_pot_gradient(r * l, r * mu, r * nu);
   grad.normalize();
 
   // The normalised negative gradient is equivalent to a unit normal
@@ -322,6 +372,9 @@ Roche_star::Roche_star(const float q1, const float t_pole1,
 
   // Set irradiation off by default
   irradiation = false;
+
+  // Solve for all surface radii by default
+  atlas = 0;
 }
 
 /*
@@ -345,6 +398,22 @@ void Roche_star::enable_irradiation(const double l_irr1,
 */
 void Roche_star::disable_irradiation() { irradiation = false; }
 
+/*
+  Use a table of lobe shapes for surface radii.  Points the table does
+  not cover are still solved for exactly.
+*/
+void Roche_star::use_atlas(const Roche_atlas *atlas1) 
+{ 
+  atlas = atlas1;
+  atlas_shape.clear();
+
+  // Interpolate the shape of this lobe if the table covers it
+  if (atlas && atlas->covers(q, fill)) {
+    atlas_shape.resize(atlas->get_shape_size());
+    atlas->get_shape(q, fill, &atlas_shape[0]);
+  }
+}
+
 /*
   Return the polar temperature
 */
@@ -412,67 +481,145 @@ float Roche_star::get_t_irr(const float r, const float l,
 */
 Surface_properties Roche_star::get_surface_properties(const float theta, 
 						      const float phi)
+{
+  Surface_properties properties;
+  get_surface_properties(1, &theta, &phi, &properties);
+  return properties;
+}
+
+/*
+  Return all the properties at the lobe surface for n points.  Points
+  are processed in blocks of BATCH_SIZE, with the surface radii for a
+  whole block found together using the same iteration as get_rad, so
+  that the inner loops are simple enough for the compiler to
+  vectorise.  Radii are interpolated from the shape table instead
+  where one is in use.
+*/
+void Roche_star::get_surface_properties(const int n, const float *theta, 
+					const float *phi, 
+					Surface_properties *properties)
 {
   // Stefan-Boltzmann constant
   using Sci_const::S;
 
-  // Convert to standard coordinate system
-  const float l = sin(theta) * cos(phi);
-  const float mu = sin(theta) * sin(phi);
-  const float nu = cos(theta);
-
-  // Calculate the surface radius
-  const float r = get_rad(l, nu);
-
-  // Convert the point to Cartesian coordinates
-  const float x = r * l;
-  const float y = r * mu;
-  const float z = r * nu;
-
-  // Evaluate the Cartesian partial derivatives of the potential
-  const float gx = (get_pot_cartesian(x + DXYZ, y, z) - 
-	      get_pot_cartesian(x - DXYZ, y, z)) / DXYZ;
-  const float gy = (get_pot_cartesian(x, y + DXYZ, z) - 
-	      get_pot_cartesian(x, y - DXYZ, z)) / DXYZ;
-  const float gz = (get_pot_cartesian(x, y, z + DXYZ) - 
-	      get_pot_cartesian(x, y, z - DXYZ)) / DXYZ;
-
-  // Calculate the surface gravity
-  const float g = sqrt(gx*gx + gy*gy + gz*gz);
-
-  // Calculate the gravity darkened temperature
-  const float temp = t_pole * pow(g / get_polar_grav(), beta);
-
-  // Determine the normal (= the normalized negative potential gradient)
-  Vec3 grad(-gx, -gy, -gz);
-  grad.normalize();
-
-  // Determine the irradiation temperature
-  float t_irr;
-  if (irradiation) {
-    // Calculate unit displacement vector and distance from
-    // irradiation source
-    Vec3 r_vec = Vec3(1.0f,0.0f,0.0f) - Vec3(x,y,z);
-    float r_abs = r_vec.mod() * get_separation();
-    r_vec.normalize();
-
-    // Irradiation flux
-    float f_irr = l_irr / r_abs / r_abs;
-
-    // Projection factor
-    float dot_product = grad * r_vec;
+  const int max_iter = 50;
+
+  // Quantities shared by all points
+  const double r_in = get_polar_rad();
+  const double r_out = get_l1();
+  const double pot_surf = get_surf_pot();
+  const float g_pole = get_polar_grav();
+
+  // Check if the shape table covers this lobe
+  const bool use_table = !atlas_shape.empty();
+
+  // Working arrays for one block
+  float l[BATCH_SIZE], mu[BATCH_SIZE], nu[BATCH_SIZE];
+  double r0[BATCH_SIZE], r1[BATCH_SIZE], r2[BATCH_SIZE];
+  bool active[BATCH_SIZE];
+
+  for (int start = 0 ; start < n ; start += BATCH_SIZE) {
+    const int m = (n - start < BATCH_SIZE) ? n - start : BATCH_SIZE;
+    int k;
+
+    // Convert to standard coordinate system
+    for (k = 0 ; k < m ; k++) {
+      l[k] = sin(theta[start+k]) * cos(phi[start+k]);
+      mu[k] = sin(theta[start+k]) * sin(phi[start+k]);
+      nu[k] = cos(theta[start+k]);
+
+      // Bracket radius point with the polar radius and the L1 point
+      r0[k] = r_in;
+      r2[k] = r_out;
+      r1[k] = (r0[k] + r2[k]) / 2.0;
+      active[k] = (r2[k] - r0[k] > TOL);
+
+      // Interpolate radius from table instead if possible
+      if (use_table && l[k] <= atlas->get_l_max()) {
+	r1[k] = atlas->get_rad(&atlas_shape[0], theta[start+k], phi[start+k]);
+	active[k] = false;
+      }
+    }
 
-    // Check for shielding by disc and evaluate irradiation temperature
-    float h = fabs(r_vec.z) / sqrt(r_vec.x * r_vec.x + r_vec.y * r_vec.y);
-    if (dot_product > 0.0f && h > disk_thick - disk_blur) {
-      t_irr = sqrt(sqrt(f_irr * dot_product * albedo / S));
-      if (h < disk_thick + disk_blur)
-	t_irr *= (h - (disk_thick - disk_blur)) / 2.0F / disk_blur;
+    // Calculate the surface radii, iterating until every point in
+    // the block has converged
+    for (int i = 0 ; i < max_iter ; i++) {
+      int n_active = 0;
+
+      for (k = 0 ; k < m ; k++) {
+	double pot, dpot, d2pot;
+	get_pot_radial(r1[k], l[k], nu[k], pot, dpot, d2pot);
+
+	const double f = pot - pot_surf;
+	const double r0_new = (f > 0.0) ? r1[k] : r0[k];
+	const double r2_new = (f > 0.0) ? r2[k] : r1[k];
+
+	const double denom = 2.0 * dpot * dpot - f * d2pot;
+	double r_new = (denom != 0.0) ? r1[k] - 2.0 * f * dpot / denom : r1[k];
+	if (!(r_new > r0_new && r_new < r2_new)) 
+	  r_new = (r0_new + r2_new) / 2.0;
+
+	// Only update points that have not yet converged
+	const double step = fabs(r_new - r1[k]);
+	if (active[k]) {
+	  r0[k] = r0_new;
+	  r2[k] = r2_new;
+	  r1[k] = r_new;
+	  active[k] = (step >= 0.01 * TOL && r2_new - r0_new > TOL);
+	}
+	n_active += active[k];
+      }
+
+      if (n_active == 0) break;
     }
-    else
-      t_irr = 0.0f;
-  } else t_irr = 0.0f;
 
-  Surface_properties properties(Vec3(x,y,z), grad, temp, t_irr);
-  return properties;
+    for (k = 0 ; k < m ; k++) {
+      // Convert the point to Cartesian coordinates
+      const float r = r1[k];
+      const float x = r * l[k];
+      const float y = r * mu[k];
+      const float z = r * nu[k];
+
+      // Evaluate the potential gradient
+      Vec3 grad = -1.0f * get_pot_gradient(x, y, z);
+
+      // Calculate the surface gravity
+      const float g = grad.mod();
+
+      // Calculate the gravity darkened temperature
+      const float temp = t_pole * pow(g / g_pole, beta);
+
+      // Determine the normal (= the normalized negative potential gradient)
+      grad.normalize();
+
+      // Determine the irradiation temperature
+      float t_irr;
+      if (irradiation) {
+	// Calculate unit displacement vector and distance from
+	// irradiation source
+	Vec3 r_vec = Vec3(1.0f,0.0f,0.0f) - Vec3(x,y,z);
+	float r_abs = r_vec.mod() * get_separation();
+	r_vec.normalize();
+
+	// Irradiation flux
+	float f_irr = l_irr / r_abs / r_abs;
+
+	// Projection factor
+	float dot_product = grad * r_vec;
+
+	// Check for shielding by disc and evaluate irradiation temperature
+	float h = fabs(r_vec.z) / sqrt(r_vec.x * r_vec.x + r_vec.y * r_vec.y);
+	if (dot_product > 0.0f && h > disk_thick - disk_blur) {
+	  t_irr = sqrt(sqrt(f_irr * dot_product * albedo / S));
+	  if (h < disk_thick + disk_blur)
+	    t_irr *= (h - (disk_thick - disk_blur)) / 2.0F / disk_blur;
+	}
+	else
+	  t_irr = 0.0f;
+      } else t_irr = 0.0f;
+
+      properties[start+k] = Surface_properties(Vec3(x,y,z), grad, temp, 
+					       t_irr);
+    }
+  }
 }
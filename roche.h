@@ -27,6 +27,7 @@
 #define _ROCHE_H
 
 #include <cmath>
+#include <vector>
 
 #include "constants.h"
 #include "mathvec.h"
@@ -34,6 +35,10 @@
 
 #include "binsim_stdinc.h"
 
+using std::vector;
+
+class Roche_atlas;
+
 /*****************************************************************************/
 
 /*
@@ -73,6 +78,10 @@ protected:
 
   float get_pot_deriv_loc(const float x);
 
+  // Potential and its first and second radial derivatives
+  void get_pot_radial(const double r, const float l, const float nu,
+		      double &pot, double &dpot_dr, double &d2pot_dr2);
+
 public:
   // Constructor.  Default parameters are used if explicit dimensions
   // are not necessary
@@ -94,6 +103,7 @@ public:
   // Potential
   float get_pot(const float r, const float l, const float nu);
   float get_pot_cartesian(const float x, const float y, const float z);
+  Vec3  get_pot_gradient(const float x, const float y, const float z);
   float get_surf_pot();
 
   // Polar radius and gravity
@@ -105,6 +115,10 @@ public:
   float get_grav(const float r, const float l, const float mu, const float nu);
   Vec3  get_normal(const float r, const float l, const float nu, 
 		   const float mu);
+
+  // Calculate every cached property now, so that the lobe can then be
+  // shared between threads
+  void prepare();
 };
 
 /*****************************************************************************/
@@ -135,6 +149,11 @@ class Roche_star: public Roche_lobe {
 
   // Flag for black hole irradiation
   bool black_hole;
+
+  // Optional table of precomputed lobe shapes, and the shape of
+  // this lobe interpolated from it
+  const Roche_atlas *atlas;
+  vector<float> atlas_shape;
 public:
   // Constructors
   Roche_star(const float q1, const float t_pole1, 
@@ -148,6 +167,9 @@ public:
 			  const bool black_hole1 = false);
   void disable_irradiation();
 
+  // Interpolate surface radii from a table where possible
+  void use_atlas(const Roche_atlas *atlas1);
+
   // Polar temperature
   float get_polar_temp();
 
@@ -159,9 +181,18 @@ public:
   float get_t_irr(const float r, const float l, const float mu, 
 		  const float nu);
 
+  // Number of points evaluated together by the batch version of
+  // get_surface_properties
+  enum { BATCH_SIZE = 16 };
+
   // Optimised convenience function to calculate all properties
   Surface_properties get_surface_properties(const float theta, 
 					    const float phi);
+
+  // Batch version for n points with angles stored in arrays
+  void get_surface_properties(const int n, const float *theta, 
+			      const float *phi, 
+			      Surface_properties *properties);
 };
 
 /*****************************************************************************/
@@ -0,0 +1,357 @@
+/*
+  Class to hold a precomputed table of Roche lobe shapes
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "constants.h"
+#include "keyword.h"
+#include "roche.h"
+#include "roche_atlas.h"
+
+// Identifier at the start of table files
+static const char atlas_magic[8] = {'B','S','A','T','L','A','S','1'};
+
+/*
+  Convert between filling factor and position along the table axis.
+  The axis is uniform in sqrt(1 - fill) since radii near the L1 point
+  vary as the square root of the departure from contact.
+*/
+static float fill_to_grid(const float fill, const float fill_min, 
+			  const float fill_max, const int n_fill)
+{
+  const float u_min = sqrt(1.0f - fill_max);
+  const float u_max = sqrt(1.0f - fill_min);
+
+  return (sqrt(1.0f - fill) - u_min) / (u_max - u_min) * (n_fill - 1);
+}
+
+static float grid_to_fill(const float x, const float fill_min, 
+			  const float fill_max, const int n_fill)
+{
+  const float u_min = sqrt(1.0f - fill_max);
+  const float u_max = sqrt(1.0f - fill_min);
+  const float u = u_min + (u_max - u_min) * x / (n_fill - 1);
+
+  return 1.0f - u * u;
+}
+
+/*****************************************************************************/
+
+/*
+  Load a table from file, mapping it into memory where possible so
+  that processes rendering many systems share a single copy
+*/
+Roche_atlas::Roche_atlas(const string filename)
+{
+  data = 0;
+  data_size = 0;
+  mapped = false;
+
+#ifndef WIN32
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw Key_list::File_access_exception(filename);
+
+  struct stat status;
+  if (fstat(fd, &status) == 0) {
+    data_size = status.st_size;
+    if (data_size > 0) {
+      data = mmap(0, data_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED) data = 0;
+      else mapped = true;
+    }
+  }
+  close(fd);
+#endif
+
+  // Fall back on reading the whole file
+  if (!data) {
+    FILE *infile;
+    if ((infile = fopen(filename.c_str(), "rb")) == NULL)
+      throw Key_list::File_access_exception(filename);
+
+    fseek(infile, 0, SEEK_END);
+    data_size = ftell(infile);
+    fseek(infile, 0, SEEK_SET);
+
+    data = new char[data_size > 0 ? data_size : 1];
+    long n_read = fread(data, 1, data_size, infile);
+    fclose(infile);
+
+    if (n_read != data_size) {
+      delete[] static_cast<char*> (data);
+      throw Key_list::File_access_exception(filename);
+    }
+  }
+
+  header = static_cast<const Header*> (data);
+  radius = reinterpret_cast<const float*> (header + 1);
+
+  // Check the file is a complete table
+  bool valid = (data_size >= (long) sizeof(Header) &&
+		!memcmp(header->magic, atlas_magic, sizeof(atlas_magic)) &&
+		header->n_q > 1 && header->n_fill > 1 &&
+		header->n_theta > 1 && header->n_phi > 1);
+  if (valid) {
+    long n_points = (long) header->n_q * header->n_fill * 
+      header->n_theta * header->n_phi;
+    valid = (data_size == (long) sizeof(Header) + n_points * 
+	     (long) sizeof(float));
+  }
+
+  if (!valid) {
+    release();
+    throw Key_list::File_format_exception(filename);
+  }
+}
+
+/*
+  Destructor
+*/
+Roche_atlas::~Roche_atlas() { release(); }
+
+/*
+  Unmap or free the memory holding the table
+*/
+void Roche_atlas::release()
+{
+#ifndef WIN32
+  if (mapped) munmap(data, data_size);
+#endif
+  if (!mapped) delete[] static_cast<char*> (data);
+  data = 0;
+}
+
+/*
+  Check if a lobe with the given mass ratio and filling factor lies
+  within the table
+*/
+bool Roche_atlas::covers(const float q, const float fill) const
+{
+  const float log_q = log10(q);
+  return (log_q >= header->log_q_min && log_q <= header->log_q_max &&
+	  fill >= header->fill_min && fill <= header->fill_max);
+}
+
+/*
+  Interpolate the shape of a lobe from the four surrounding tabulated
+  lobes
+*/
+void Roche_atlas::get_shape(const float q, const float fill, 
+			    float *shape) const
+{
+  const int n_q = header->n_q, n_fill = header->n_fill;
+  const int n_shape = get_shape_size();
+
+  // Fractional grid positions
+  const float x_q = (log10(q) - header->log_q_min) / 
+    (header->log_q_max - header->log_q_min) * (n_q - 1);
+  const float x_fill = fill_to_grid(fill, header->fill_min, 
+				    header->fill_max, n_fill);
+
+  // Lower grid indices and interpolation weights
+  int i_q = static_cast<int> (floor(x_q));
+  i_q = (i_q < 0) ? 0 : ((i_q > n_q - 2) ? n_q - 2 : i_q);
+  int i_fill = static_cast<int> (floor(x_fill));
+  i_fill = (i_fill < 0) ? 0 : ((i_fill > n_fill - 2) ? n_fill - 2 : i_fill);
+
+  const float w_q = x_q - i_q;
+  const float w_fill = x_fill - i_fill;
+
+  // Surrounding tabulated shapes
+  const float *r00 = radius + (i_q * n_fill + i_fill) * n_shape;
+  const float *r01 = r00 + n_shape;
+  const float *r10 = r00 + n_fill * n_shape;
+  const float *r11 = r10 + n_shape;
+
+  for (int k = 0 ; k < n_shape ; k++)
+    shape[k] = (1.0f - w_q) * ((1.0f - w_fill) * r00[k] + w_fill * r01[k]) +
+      w_q * ((1.0f - w_fill) * r10[k] + w_fill * r11[k]);
+}
+
+/*
+  Return the radius of a lobe shape in a given direction.  Only one
+  quadrant is tabulated so other directions are reflected into it.
+*/
+float Roche_atlas::get_rad(const float *shape, const float theta, 
+			   const float phi) const
+{
+  using Sci_const::PI;
+
+  const int n_theta = header->n_theta, n_phi = header->n_phi;
+
+  // Reflect about the orbital plane and the line of centres
+  float theta1 = fmod(theta, 2.0f * PI);
+  theta1 = (theta1 < 0.0f) ? -theta1 : theta1;
+  theta1 = (theta1 > PI) ? 2.0f * PI - theta1 : theta1;
+  theta1 = (theta1 > 0.5f * PI) ? PI - theta1 : theta1;
+
+  float phi1 = fmod(phi, 2.0f * PI);
+  phi1 = (phi1 < 0.0f) ? phi1 + 2.0f * PI : phi1;
+  phi1 = (phi1 > PI) ? 2.0f * PI - phi1 : phi1;
+
+  // Fractional grid positions
+  const float x_theta = theta1 / (0.5f * PI) * (n_theta - 1);
+  const float x_phi = phi1 / PI * (n_phi - 1);
+
+  // Lower grid indices and interpolation weights
+  int i_theta = static_cast<int> (x_theta);
+  i_theta = (i_theta > n_theta - 2) ? n_theta - 2 : i_theta;
+  int i_phi = static_cast<int> (x_phi);
+  i_phi = (i_phi > n_phi - 2) ? n_phi - 2 : i_phi;
+
+  const float w_theta = x_theta - i_theta;
+  const float w_phi = x_phi - i_phi;
+
+  // Bilinear interpolation
+  const float *r0 = shape + i_theta * n_phi + i_phi;
+  const float *r1 = r0 + n_phi;
+
+  return (1.0f - w_theta) * ((1.0f - w_phi) * r0[0] + w_phi * r0[1]) +
+    w_theta * ((1.0f - w_phi) * r1[0] + w_phi * r1[1]);
+}
+
+/*
+  Generate a table by solving for the radius at every grid node and
+  write it to file.  The interpolation error is then measured midway
+  between nodes, stored in the file and returned.
+*/
+float Roche_atlas::generate(const string filename, 
+			    const int n_q, const int n_fill, 
+			    const int n_theta, const int n_phi, 
+			    const float log_q_min, const float log_q_max,
+			    const float fill_min, const float fill_max,
+			    const float l_max)
+{
+  using Sci_const::PI;
+
+  FILE *outfile;
+  if ((outfile = fopen(filename.c_str(), "wb")) == NULL) 
+    throw Key_list::File_access_exception(filename);
+
+  // Write header, with error to be filled in later
+  Header new_header;
+  memcpy(new_header.magic, atlas_magic, sizeof(atlas_magic));
+  new_header.n_q = n_q;
+  new_header.n_fill = n_fill;
+  new_header.n_theta = n_theta;
+  new_header.n_phi = n_phi;
+  new_header.log_q_min = log_q_min;
+  new_header.log_q_max = log_q_max;
+  new_header.fill_min = fill_min;
+  new_header.fill_max = fill_max;
+  new_header.l_max = l_max;
+  new_header.max_error = 0.0f;
+  fwrite(&new_header, sizeof(Header), 1, outfile);
+
+  // Solve for radii one lobe at a time
+  float *row = new float[n_phi];
+  for (int i_q = 0 ; i_q < n_q ; i_q++) {
+    float q = pow(10.0f, log_q_min + (log_q_max - log_q_min) * i_q / 
+		  (n_q - 1));
+
+    for (int i_fill = 0 ; i_fill < n_fill ; i_fill++) {
+      float fill = grid_to_fill(i_fill, fill_min, fill_max, n_fill);
+      Roche_lobe lobe(q, 1.0f * Sci_const::DAY, 1.0f * Sci_const::MSUN, fill);
+
+      for (int i_theta = 0 ; i_theta < n_theta ; i_theta++) {
+	float theta = 0.5f * PI * i_theta / (n_theta - 1);
+
+	for (int i_phi = 0 ; i_phi < n_phi ; i_phi++) {
+	  float phi = PI * i_phi / (n_phi - 1);
+	  row[i_phi] = lobe.get_rad(sin(theta) * cos(phi), cos(theta));
+	}
+	fwrite(row, sizeof(float), n_phi, outfile);
+      }
+    }
+  }
+  delete[] row;
+  fclose(outfile);
+
+  // Measure error at the midpoints of the grid cells
+  float max_error = Roche_atlas(filename).measure_error();
+
+  // Record the error in the header
+  new_header.max_error = max_error;
+  if ((outfile = fopen(filename.c_str(), "r+b")) == NULL) 
+    throw Key_list::File_access_exception(filename);
+  fwrite(&new_header, sizeof(Header), 1, outfile);
+  fclose(outfile);
+
+  return max_error;
+}
+
+/*
+  Return the largest interpolation error at the midpoints of the grid
+  cells, compared with radii solved for exactly
+*/
+float Roche_atlas::measure_error() const
+{
+  using Sci_const::PI;
+
+  const int n_q = header->n_q, n_fill = header->n_fill;
+  const int n_theta = header->n_theta, n_phi = header->n_phi;
+
+  float *shape = new float[get_shape_size()];
+  float max_error = 0.0f;
+  for (int i_q = 0 ; i_q < n_q - 1 ; i_q++) {
+    float q = pow(10.0f, header->log_q_min + 
+		  (header->log_q_max - header->log_q_min) * 
+		  (i_q + 0.5f) / (n_q - 1));
+
+    for (int i_fill = 0 ; i_fill < n_fill - 1 ; i_fill++) {
+      float fill = grid_to_fill(i_fill + 0.5f, header->fill_min, 
+				header->fill_max, header->n_fill);
+      Roche_lobe lobe(q, 1.0f * Sci_const::DAY, 1.0f * Sci_const::MSUN, fill);
+      get_shape(q, fill, shape);
+
+      for (int i_theta = 0 ; i_theta < n_theta - 1 ; i_theta++) {
+	float theta = 0.5f * PI * (i_theta + 0.5f) / (n_theta - 1);
+
+	for (int i_phi = 0 ; i_phi < n_phi - 1 ; i_phi++) {
+	  float phi = PI * (i_phi + 0.5f) / (n_phi - 1);
+
+	  float l = sin(theta) * cos(phi);
+	  float nu = cos(theta);
+	  if (l > header->l_max) continue;
+
+	  float error = fabs(get_rad(shape, theta, phi) - lobe.get_rad(l, nu));
+	  if (error > max_error) max_error = error;
+	}
+      }
+    }
+  }
+  delete[] shape;
+
+  return max_error;
+}
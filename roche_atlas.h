@@ -0,0 +1,109 @@
+/*
+  Class to hold a precomputed table of Roche lobe shapes
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _ROCHE_ATLAS_H
+#define _ROCHE_ATLAS_H
+
+#include <string>
+
+#include "binsim_stdinc.h"
+
+using std::string;
+
+/*****************************************************************************/
+
+/*
+  Table of Roche lobe radii, in units of the binary separation, on a
+  grid of log mass ratio, filling factor and direction.  Only one
+  quadrant of directions is stored as lobes are symmetric about the
+  orbital plane and the line of centres.  Tables are generated offline
+  by roche_atlas_gen and mapped into memory when loaded.
+*/
+class Roche_atlas {
+  // File header.  All fields are four bytes so the table that follows
+  // remains aligned
+  struct Header {
+    char magic[8];
+    int n_q, n_fill, n_theta, n_phi;
+    float log_q_min, log_q_max, fill_min, fill_max;
+    float l_max, max_error;
+  };
+
+  // Header and radii, ordered by q, fill, theta and then phi
+  const Header *header;
+  const float *radius;
+
+  // Memory holding the file contents, and whether it was mapped
+  void *data;
+  long data_size;
+  bool mapped;
+
+  // Unmap or free the table
+  void release();
+
+  // Largest interpolation error midway between grid nodes
+  float measure_error() const;
+
+  // Not copyable
+  Roche_atlas(const Roche_atlas&);
+  Roche_atlas& operator= (const Roche_atlas&);
+public:
+  // Load a table from file
+  Roche_atlas(const string filename);
+  ~Roche_atlas();
+
+  // Generate a table by solving for every grid point and write it to
+  // file.  The maximum interpolation error is measured and stored
+  static float generate(const string filename, 
+			const int n_q, const int n_fill, 
+			const int n_theta, const int n_phi, 
+			const float log_q_min, const float log_q_max,
+			const float fill_min, const float fill_max,
+			const float l_max);
+
+  // Check if a lobe lies within the table
+  bool covers(const float q, const float fill) const;
+
+  // Directions with l greater than this are too close to the L1 point,
+  // where the lobe surface can form a cusp, and must be solved for
+  float get_l_max() const { return header->l_max; }
+
+  // Largest interpolation error found when table was generated
+  float get_max_error() const { return header->max_error; }
+
+  // Number of radii describing the shape of one lobe
+  int get_shape_size() const { return header->n_theta * header->n_phi; }
+
+  // Shape of one lobe interpolated in mass ratio and filling factor
+  void get_shape(const float q, const float fill, float *shape) const;
+
+  // Radius of a lobe shape at polar angle theta and azimuth phi
+  float get_rad(const float *shape, const float theta, 
+		const float phi) const;
+};
+
+/*****************************************************************************/
+
+#endif
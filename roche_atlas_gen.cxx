@@ -0,0 +1,87 @@
+/*
+  Generate a table of Roche lobe shapes for use with ROCHE_ATLAS
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+#include <iostream>
+#include <string>
+
+#include <cstdlib>
+
+#include "keyword.h"
+#include "roche_atlas.h"
+
+#include "binsim_stdinc.h"
+
+using std::cout;
+
+/*****************************************************************************/
+
+int main(int argc, char** argv)
+{
+  // Table dimensions: log q, filling factor, polar angle, azimuth
+  int n_q = 41, n_fill = 21, n_theta = 46, n_phi = 91;
+
+  // Table limits
+  const float log_q_min = -2.0f, log_q_max = 2.0f;
+  const float fill_min = 0.5f, fill_max = 1.0f;
+
+  // Directions closer than this (as a cosine) to L1 are always solved
+  const float l_max = 0.9f;
+
+  // Get output file name and optional dimensions
+  if (argc != 2 && argc != 6) {
+    cout << "Usage: roche_atlas_gen atlasfile [n_q n_fill n_theta n_phi]\n";
+    exit(1);
+  }
+  string filename = argv[1];
+  if (argc == 6) {
+    n_q = atoi(argv[2]);
+    n_fill = atoi(argv[3]);
+    n_theta = atoi(argv[4]);
+    n_phi = atoi(argv[5]);
+
+    if (n_q < 2 || n_fill < 2 || n_theta < 2 || n_phi < 2) {
+      cout << "All table dimensions must be at least 2\n";
+      exit(1);
+    }
+  }
+
+  cout << "Generating " << n_q << " x " << n_fill << " x " << n_theta 
+       << " x " << n_phi << " Roche lobe atlas...\n";
+
+  try {
+    float max_error = Roche_atlas::generate(filename, n_q, n_fill, 
+					    n_theta, n_phi, 
+					    log_q_min, log_q_max, 
+					    fill_min, fill_max, l_max);
+    cout << "Maximum interpolation error " << max_error 
+	 << " binary separations\n";
+  }
+  catch (Key_list::File_access_exception e) {
+    cout << "File access error: " << e << "\n\nTerminating program!\n";
+    exit(1);
+  }
+
+  return 0;
+}
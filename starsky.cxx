@@ -24,12 +24,12 @@
 */
 
 #include <cmath>
-#include <cstdlib>
 
 #include <iostream>
 
 #include "constants.h"
 #include "errmsg.h"
+#include "random_stream.h"
 #include "starsky.h"
 
 using std::cout;
@@ -90,6 +90,16 @@ Star_sky::Star_sky(const float x0, const float x1,
     star_size *= 0.0015f * dx;
   }
 
+  // Get seed for star positions and colours silently - error
+  // messages will be logged by Binary_3d.  Key 0 keeps the stars
+  // distinct from the binary components, which use keys from 1
+  int seed;
+  try { seed = params.get_int("SEED"); }
+  catch (Key_list::Key_not_found_exception) {
+    seed = 0;
+  }
+  Random_stream random(seed, 0);
+
   // Initialise arrays
   red_grid = new GLfloat[n_star];
   green_grid = new GLfloat[n_star];
@@ -101,8 +111,9 @@ Star_sky::Star_sky(const float x0, const float x1,
     coord_grid[i] = new GLfloat[3];
 
     // Calculate random position within desired window
-    float x = (((float) rand()) / RAND_MAX) * dx - 0.5f * dx;
-    float y = (((float) rand()) / RAND_MAX) * dy - 0.5f * dy;
+    Random_stream star_random = random.substream(i);
+    float x = star_random.uniform() * dx - 0.5f * dx;
+    float y = star_random.uniform() * dy - 0.5f * dy;
     
     *(coord_grid[i]) = x0 + x + 0.5f * dx;
     *(coord_grid[i]+1) = y0 + y + 0.5f * dy; 
@@ -111,8 +122,8 @@ Star_sky::Star_sky(const float x0, const float x1,
     *(coord_grid[i]+2) = -8.0f;
 
     // Determine random colour of stars
-    float max_colour = ((float) rand()) / RAND_MAX;
-    float colour_bias = (((float) rand()) / RAND_MAX - 0.5f) * colour_range;
+    float max_colour = star_random.uniform();
+    float colour_bias = (star_random.uniform() - 0.5f) * colour_range;
 
     // Star is blue
     if (colour_bias < 0.0f) {
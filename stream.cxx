@@ -32,7 +32,8 @@
 /*
   Constructor to initialise the stream model
 */
-Stream::Stream(const float q1, const float m1, const float period1)
+Stream::Stream(const float q1, const float m1, const float period1,
+	       const int method1)
 {
   using namespace Sci_const;
 
@@ -47,6 +48,8 @@ Stream::Stream(const float q1, const float m1, const float period1)
   period = period1;
   omega  = 2.0 * PI / period;
 
+  method = method1;
+
   // Calculate sensible timestep
   dt = 2e-6 * period;
 
@@ -59,46 +62,65 @@ Stream::Stream(const float q1, const float m1, const float period1)
   al1   = a * lobe.get_l1();
 
   r_egg = lobe.get_eggleton() * a;
+
+  // Start just inside the L1 point, corotating with the binary
+  pos.y = al1 - a1 - 0.001 * a ;
+  vel.x = -omega * pos.y;
+
+  // Store initial coordinates in corotating frame
+  first_point.x = -pos.y / a;
+  first_point.y = pos.x / a;
+
+  // Same starting point in corotating units, initially at rest
+  y_rot[0] = first_point.x;
+  y_rot[1] = first_point.y;
+  y_rot[2] = 0.0;
+  y_rot[3] = 0.0;
+
+  t_rot = 0.0;
+  h_rot = 1e-3;
 }
 
 /*
-  Calculate a stream trajectory
+  Check if stream was calculated for the given binary parameters
 */
-vector<Vec3> Stream::stream_calc(const float dl, const float r_max)
+bool Stream::matches(const float q1, const float m1, const float period1,
+		     const int method1)
 {
-  // Integated time
-  float t = 0.0f;
+  return (q == q1 && m_prim == m1 && period == period1 && method == method1);
+}
 
-  // Stream positions and times
-  vector<Vec3> result;
-  vector<float> times;
+/*
+  Integrate the trajectory until it comes within r_min of the
+  primary.  Integration resumes from wherever a previous call stopped.
+*/
+void Stream::integrate(const float r_min)
+{
+  if (method == EULER) integrate_euler(r_min);
+  else integrate_rk45(r_min);
+}
 
-  // Position and velocity vectors
-  Vec3 pos;
-  pos.y = al1 - a1 - 0.001 * a ;
+/*
+  Integrate with fixed timestep Euler steps in the inertial frame
+*/
+void Stream::integrate_euler(const float r_min)
+{
+  // Step number and integrated time
+  long i = path.size();
+  float t = (i > 0) ? path.back().t1 * period : 0.0f;
 
-  Vec3 vel;
-  vel.x = -omega * pos.y;
+  const float maxit = 2e5;
 
-  Vec3 dr1, dr2, drl1, dv;
+  Vec3 dr1, dr2, dv;
 
   // Points in corotating frame
-  Vec3 first_point, last_point, new_point;
+  Vec3 new_point;
+  Vec3 last_point = (i > 0) ? path.back().c0 + path.back().c1 : first_point;
 
-  // Store initial coordinates
-  first_point.x = -pos.y / a;
-  first_point.y = pos.x / a;
-  last_point = first_point;
-  result.push_back(first_point);  
-
-  long i = 0;
-
-  const float maxit = 2e5;
-
-  float moddr1, moddr2, moddrl1;
+  float moddr1, moddr2;
 
   // Iterate over steps
-  do {
+  while (i < maxit && get_r1(last_point) > r_min / a) {
     // Get sine and cosine of phase angle
     float angle = omega * i * dt;
     float sine   = sin(angle);
@@ -107,11 +129,9 @@ vector<Vec3> Stream::stream_calc(const float dl, const float r_max)
     // Get displacements from stellar components
     dr1 = pos + a1 * Vec3(-sine, cosine, 0.0f);
     dr2 = pos + a2 * Vec3(sine, -cosine, 0.0f);
-    drl1 = pos + al1 * Vec3(sine, -cosine, 0.0f);
       
     moddr1  = dr1.mod();
     moddr2  = dr2.mod();
-    moddrl1 = drl1.mod();
     
     // Calculate velocity change due to gravity
     dv = -dt * (gm1 * dr1 / moddr1 / moddr1 / moddr1 +
@@ -121,32 +141,280 @@ vector<Vec3> Stream::stream_calc(const float dl, const float r_max)
     pos += vel * dt;
     vel += dv;
 
-    // Update time
-    t += dt;
-
     // Rotate positions and velocities so they are relative to line of
-    // centres, convert to units of binary separation or km/s and store
-    // in return array
+    // centres, convert to units of binary separation
     new_point.x = (pos.x  * sine   - pos.y  * cosine) / a;
     new_point.y = (pos.x  * cosine + pos.y  * sine) / a;
-    
-    // Check if point is to be stored
-    if ((new_point - last_point).mod() >= dl) {
-      result.push_back(new_point);
-      last_point = new_point;
-      times.push_back(t);
+
+    // Store as a straight line step
+    Step step;
+    step.c0 = last_point;
+    step.c1 = new_point - last_point;
+    step.t0 = t / period;
+    step.t1 = (t + dt) / period;
+    path.push_back(step);
+
+    t += dt;
+    last_point = new_point;
+    i++;
+  }
+}
+
+/*
+  Derivatives of position and velocity in the corotating frame, in
+  units where the separation, total mass and angular frequency are
+  all unity.  The primary lies on the positive x axis.
+*/
+void Stream::rotating_deriv(const double *y, double *dydt)
+{
+  const double mu1 = 1.0 / (1.0 + q);
+  const double mu2 = q / (1.0 + q);
+  const double x1 = a1 / a;
+  const double x2 = x1 - 1.0;
+
+  double dx1 = y[0] - x1, dx2 = y[0] - x2;
+  double r1 = sqrt(dx1 * dx1 + y[1] * y[1]);
+  double r2 = sqrt(dx2 * dx2 + y[1] * y[1]);
+  double g1 = mu1 / (r1 * r1 * r1);
+  double g2 = mu2 / (r2 * r2 * r2);
+
+  // Gravity, centrifugal and Coriolis accelerations
+  dydt[0] = y[2];
+  dydt[1] = y[3];
+  dydt[2] = -g1 * dx1 - g2 * dx2 + y[0] + 2.0 * y[3];
+  dydt[3] = -(g1 + g2) * y[1] + y[1] - 2.0 * y[2];
+}
+
+/*
+  Integrate with adaptive Dormand-Prince 5(4) steps in the corotating
+  frame, keeping the continuous extension of each step so the
+  trajectory can be resampled at any spacing
+*/
+void Stream::integrate_rk45(const float r_min)
+{
+  using Sci_const::PI;
+
+  // Dormand-Prince coefficients
+  const double a21 = 1.0/5.0;
+  const double a31 = 3.0/40.0, a32 = 9.0/40.0;
+  const double a41 = 44.0/45.0, a42 = -56.0/15.0, a43 = 32.0/9.0;
+  const double a51 = 19372.0/6561.0, a52 = -25360.0/2187.0;
+  const double a53 = 64448.0/6561.0, a54 = -212.0/729.0;
+  const double a61 = 9017.0/3168.0, a62 = -355.0/33.0;
+  const double a63 = 46732.0/5247.0, a64 = 49.0/176.0;
+  const double a65 = -5103.0/18656.0;
+  const double a71 = 35.0/384.0, a73 = 500.0/1113.0, a74 = 125.0/192.0;
+  const double a75 = -2187.0/6784.0, a76 = 11.0/84.0;
+  const double e1 = 71.0/57600.0, e3 = -71.0/16695.0, e4 = 71.0/1920.0;
+  const double e5 = -17253.0/339200.0, e6 = 22.0/525.0, e7 = -1.0/40.0;
+
+  // Dense output coefficients
+  const double d1 = -12715105075.0/11282082432.0;
+  const double d3 = 87487479700.0/32700410799.0;
+  const double d4 = -10690763975.0/1880347072.0;
+  const double d5 = 701980252875.0/199316789632.0;
+  const double d6 = -1453857185.0/822651844.0;
+  const double d7 = 69997945.0/29380423.0;
+
+  // Error tolerances and step limit
+  const double rtol = 1e-8, atol = 1e-8;
+  const long maxit = 100000;
+
+  double k1[4], k2[4], k3[4], k4[4], k5[4], k6[4], k7[4];
+  double y_tmp[4], y_new[4];
+
+  long i = 0;
+  Vec3 last_point = (path.size() > 0) ? get_point(path.back(), 1.0f) : 
+    first_point;
+
+  rotating_deriv(y_rot, k1);
+
+  // Iterate over steps
+  while (i < maxit && get_r1(last_point) > r_min / a) {
+    double h = h_rot;
+    int j;
+
+    // Runge-Kutta stages
+    for (j = 0 ; j < 4 ; j++) y_tmp[j] = y_rot[j] + h * a21 * k1[j];
+    rotating_deriv(y_tmp, k2);
+    for (j = 0 ; j < 4 ; j++) 
+      y_tmp[j] = y_rot[j] + h * (a31 * k1[j] + a32 * k2[j]);
+    rotating_deriv(y_tmp, k3);
+    for (j = 0 ; j < 4 ; j++) 
+      y_tmp[j] = y_rot[j] + h * (a41 * k1[j] + a42 * k2[j] + a43 * k3[j]);
+    rotating_deriv(y_tmp, k4);
+    for (j = 0 ; j < 4 ; j++) 
+      y_tmp[j] = y_rot[j] + h * (a51 * k1[j] + a52 * k2[j] + a53 * k3[j] + 
+				 a54 * k4[j]);
+    rotating_deriv(y_tmp, k5);
+    for (j = 0 ; j < 4 ; j++) 
+      y_tmp[j] = y_rot[j] + h * (a61 * k1[j] + a62 * k2[j] + a63 * k3[j] + 
+				 a64 * k4[j] + a65 * k5[j]);
+    rotating_deriv(y_tmp, k6);
+    for (j = 0 ; j < 4 ; j++) 
+      y_new[j] = y_rot[j] + h * (a71 * k1[j] + a73 * k3[j] + a74 * k4[j] + 
+				 a75 * k5[j] + a76 * k6[j]);
+    rotating_deriv(y_new, k7);
+
+    // Estimate error relative to tolerance
+    double err = 0.0;
+    for (j = 0 ; j < 4 ; j++) {
+      double err_j = h * (e1 * k1[j] + e3 * k3[j] + e4 * k4[j] + 
+			  e5 * k5[j] + e6 * k6[j] + e7 * k7[j]);
+      double scale = atol + rtol * fmax(fabs(y_rot[j]), fabs(y_new[j]));
+      err += (err_j / scale) * (err_j / scale);
     }
-    
+    err = sqrt(err / 4.0);
+
+    // Choose next step size, limiting changes to a factor of five
+    double fac = (err > 0.0) ? 0.9 * pow(err, -0.2) : 5.0;
+    fac = fmin(5.0, fmax(0.2, fac));
+    h_rot = h * fac;
     i++;
-  } while(moddr1 > r_max * r_egg && i < maxit);
+
+    // Reject step and retry with smaller step size
+    if (err > 1.0) continue;
+
+    // Store position part of continuous extension
+    double rc0[2], rc1[2], rc2[2], rc3[2], rc4[2];
+    for (j = 0 ; j < 2 ; j++) {
+      rc0[j] = y_rot[j];
+      rc1[j] = y_new[j] - y_rot[j];
+      rc2[j] = h * k1[j] - rc1[j];
+      rc3[j] = rc1[j] - h * k7[j] - rc2[j];
+      rc4[j] = h * (d1 * k1[j] + d3 * k3[j] + d4 * k4[j] + d5 * k5[j] + 
+		    d6 * k6[j] + d7 * k7[j]);
+    }
+
+    Step step;
+    step.c0 = Vec3(rc0[0], rc0[1], 0.0f);
+    step.c1 = Vec3(rc1[0], rc1[1], 0.0f);
+    step.c2 = Vec3(rc2[0], rc2[1], 0.0f);
+    step.c3 = Vec3(rc3[0], rc3[1], 0.0f);
+    step.c4 = Vec3(rc4[0], rc4[1], 0.0f);
+    step.t0 = t_rot / (2.0 * PI);
+    step.t1 = (t_rot + h) / (2.0 * PI);
+    path.push_back(step);
+
+    // Advance, reusing final stage as first stage of the next step
+    for (j = 0 ; j < 4 ; j++) {
+      y_rot[j] = y_new[j];
+      k1[j] = k7[j];
+    }
+    t_rot += h;
+    last_point = Vec3(y_rot[0], y_rot[1], 0.0f);
+  }
+}
+
+/*
+  Return position at fraction s (0-1) through an integration step
+*/
+Vec3 Stream::get_point(const Step &step, const float s)
+{
+  return step.c0 + s * (step.c1 + (1.0f - s) * 
+			(step.c2 + s * (step.c3 + (1.0f - s) * step.c4)));
+}
+
+/*
+  Return distance of a point from the primary in units of separation
+*/
+float Stream::get_r1(const Vec3 point)
+{
+  return (point - Vec3(a1 / a, 0.0f, 0.0f)).mod();
+}
+
+/*
+  Calculate a stream trajectory with points spaced by dl, ending when
+  the stream comes within r_max Eggleton radii of the primary
+*/
+vector<Vec3> Stream::stream_calc(const float dl, const float r_max, 
+				 float *speed)
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  // Closest approach to the primary in units of separation
+  const float r_min = r_max * r_egg / a;
+
+  // Number of bisections to locate points within a step
+  const int n_bisect = 30;
+
+  // Ensure the trajectory has been integrated far enough
+  integrate(r_min * a);
+
+  // Stream positions and times
+  vector<Vec3> result;
+  vector<float> times;
+
+  Vec3 last_point = first_point;
+  result.push_back(first_point);
+  times.push_back(0.0f);
+
+  // Resample the trajectory at the requested spacing
+  for (unsigned long i = 0 ; i < path.size() ; i++) {
+    // Find where the step crosses the cutoff radius, if it does
+    float s_end = 1.0f;
+    bool cutoff = !(get_r1(get_point(path[i], 1.0f)) > r_min);
+    if (cutoff) {
+      float s_lo = 0.0f;
+      for (int j = 0 ; j < n_bisect ; j++) {
+	float s_mid = 0.5f * (s_lo + s_end);
+	if (get_r1(get_point(path[i], s_mid)) > r_min) s_lo = s_mid;
+	else s_end = s_mid;
+      }
+    }
+
+    // Store points where the step is dl from the last stored point
+    float s_start = 0.0f;
+    while ((get_point(path[i], s_end) - last_point).mod() >= dl) {
+      float s_lo = s_start, s_hi = s_end;
+      for (int j = 0 ; j < n_bisect ; j++) {
+	float s_mid = 0.5f * (s_lo + s_hi);
+	if ((get_point(path[i], s_mid) - last_point).mod() < dl) s_lo = s_mid;
+	else s_hi = s_mid;
+      }
+
+      last_point = get_point(path[i], s_hi);
+      result.push_back(last_point);
+      times.push_back(path[i].t0 + s_hi * (path[i].t1 - path[i].t0));
+      s_start = s_hi;
+    }
+
+    // Stop once the cutoff radius is reached
+    if (cutoff) break;
+  }
 
   // Calculated normalised midpoint stream speed
   int mid_index = result.size() / 2;
   float delta_pos = (result[mid_index+1] - result[mid_index]).mod();
-  float delta_t = (times[mid_index+1] - times[mid_index]) / period;
-  speed = delta_pos / delta_t;
+  float delta_t = times[mid_index+1] - times[mid_index];
+  if (speed) *speed = delta_pos / delta_t;
 
   // Return trajectory
   return result;
 }
 
+/*****************************************************************************/
+
+/*
+  Delete all cached streams
+*/
+Stream_cache::~Stream_cache()
+{
+  for (unsigned long i = 0 ; i < streams.size() ; i++) delete streams[i];
+}
+
+/*
+  Return the stream for the given binary parameters, creating it if it
+  has not been requested before
+*/
+Stream& Stream_cache::get_stream(const float q, const float m1, 
+				 const float period)
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  for (unsigned long i = 0 ; i < streams.size() ; i++)
+    if (streams[i]->matches(q, m1, period, method)) return *streams[i];
+
+  streams.push_back(new Stream(q, m1, period, method));
+  return *streams.back();
+}
@@ -26,6 +26,7 @@
 #ifndef _STREAM_H
 #define _STREAM_H
 
+#include <mutex>
 #include <vector>
 
 #include "mathvec.h"
@@ -37,26 +38,104 @@ using std::vector;
 /*****************************************************************************/
 
 class Stream {
+public:
+  // Available integration methods
+  enum { EULER, RK45 };
 private:
   // Binary parameters
   float q, m_prim, m_sec, gm1, gm2;
   float period, omega;
   float a, a1, a2, al1, r_egg;
 
-  // Timestep
+  // Integration method
+  int method;
+
+  // Timestep for Euler integration
   float dt;
 
-  // Normalised midpoint stream speed = delta_x/a / delta_t/P
-  float speed;
+  // Trajectory in corotating frame as a series of integration steps,
+  // each with dense output coefficients so that the position at
+  // fraction s through the step is 
+  // c0 + s*(c1 + (1-s)*(c2 + s*(c3 + (1-s)*c4)))
+  struct Step {
+    Vec3 c0, c1, c2, c3, c4;
+    float t0, t1;
+  };
+
+  vector<Step> path;
+
+  // Serialise integration and resampling between threads
+  std::mutex lock;
+
+  // Starting point of the trajectory in corotating frame
+  Vec3 first_point;
+
+  // Current position and velocity for Euler integration in the
+  // inertial frame, so the integration can be resumed
+  Vec3 pos, vel;
+
+  // Current position, velocity, time and step size for RK45
+  // integration in the corotating frame, in units of the binary
+  // separation and 1/omega
+  double y_rot[4], t_rot, h_rot;
+
+  // Integrate the trajectory until it comes within r_min of the primary
+  void integrate(const float r_min);
+  void integrate_euler(const float r_min);
+  void integrate_rk45(const float r_min);
+
+  // Acceleration in the corotating frame
+  void rotating_deriv(const double *y, double *dydt);
+
+  // Position and distance from primary part way through a step
+  Vec3 get_point(const Step &step, const float s);
+  float get_r1(const Vec3 point);
 public:
   // Constructor
-  Stream(const float q1, const float m1, const float period1);
+  Stream(const float q1, const float m1, const float period1,
+	 const int method1 = RK45);
+
+  // Check if stream was calculated for the given binary parameters
+  bool matches(const float q1, const float m1, const float period1,
+	       const int method1);
+
+  // Calculate a stream trajectory, optionally returning the
+  // normalised midpoint stream speed = delta_x/a / delta_t/P
+  vector<Vec3> stream_calc(const float dl, const float r_max, 
+			   float *speed = 0);
+
+};
+
+/*****************************************************************************/
+
+/*
+  Class to hold stream trajectories so that they are only integrated
+  once however many components need them
+*/
+class Stream_cache {
+  // Trajectories calculated so far
+  vector<Stream*> streams;
+
+  // Integration method for new trajectories
+  int method;
+
+  // Serialise lookups between threads
+  std::mutex lock;
+
+  // Not copyable
+  Stream_cache(const Stream_cache&);
+  Stream_cache& operator= (const Stream_cache&);
+public:
+  // Constructor and destructor
+  Stream_cache() : method(Stream::RK45) { }
+  ~Stream_cache();
 
-  // Calculate a stream trajectory
-  vector<Vec3> stream_calc(const float dl, const float r_max);
+  // Select integration method for subsequent trajectories
+  void set_method(const int method1) { method = method1; }
 
-  // Return the stream speed
-  float get_speed() { return speed; }
+  // Return the stream for the given binary parameters, creating it if
+  // necessary
+  Stream& get_stream(const float q, const float m1, const float period);
 };
 
 /*****************************************************************************/
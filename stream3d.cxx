@@ -45,8 +45,9 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
 		     const float period, const float disc_rad, 
 		     const float t_pole, const float max_stream_thick,
 		     const float open_angle, 
-		     const float red, const float green, 
-		     const float blue, const float opacity)
+		     const float red1, const float green1, 
+		     const float blue1, const float opacity1,
+		     Stream_cache &streams, const Random_stream &random)
   : Transparent_object_3d(phase, n_phi1, 1, inclination)
 {
   using Sci_const::PI;
@@ -65,11 +66,11 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
   // Create model to describe donor lobe properties
   Roche_lobe donor_lobe(q, period, m_prim * q);
 
-  // Create stream model
-  Stream stream_model(q, m_prim, period);
-  stream = stream_model.stream_calc(0.01f, 0.9f * disc_rad);
-  float stream_speed = stream_model.get_speed();
-  float stream_period = (stream[stream.size()-1] - stream[0]).mod() / 
+  // Get stream model
+  Stream &stream_model = streams.get_stream(q, m_prim, period);
+  float stream_speed;
+  stream = stream_model.stream_calc(0.01f, 0.9f * disc_rad, &stream_speed);
+  stream_period = (stream[stream.size()-1] - stream[0]).mod() / 
     stream_speed;
 
   // Create extension of stream back to overlap L1 point
@@ -78,13 +79,9 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
   // Extrapolate stream backwards by one point
   stream.insert(stream.begin(), ext_point);
 
-  // Delete existing arrays (created by superclass) so they can be
-  // replaced with correct size versions
-  delete[] red_grid;
-  delete[] green_grid;
-  delete[] blue_grid;
-  delete[] alpha_grid;
-
+  // Delete existing coordinate array (created by superclass) so it
+  // can be replaced with a correct size version.  Colour grids are
+  // not allocated until the colour mode is chosen
   for (i = 0; i < n_vert; i++) delete[] coord_grid[i];
   delete[] coord_grid;
 
@@ -102,12 +99,7 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
     x[i] = l;
   }
 
-  // Create stream surface grids
-  red_grid = new GLfloat[n_phase*n_vert];
-  green_grid = new GLfloat[n_phase*n_vert];
-  blue_grid = new GLfloat[n_phase*n_vert];
-  alpha_grid = new GLfloat[n_phase*n_vert];
-
+  // Create stream surface grid
   coord_grid = new GLfloat*[n_vert];
   for (i = 0 ; i < n_vert ; i++) coord_grid[i] = new GLfloat[3]; 
 
@@ -116,9 +108,6 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
   Vec3 basis_parallel, basis_perp;
   Vec3 rad_vect, pos_vect;
 
-  // Opacity
-  float alpha;
-
   // Estimate sound speed at L1 point
   float c_s = 10000.0f * sqrt(0.75f * t_pole / 10000.0f);
 
@@ -127,12 +116,23 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
   stream_rad = (stream_rad < max_stream_thick) ? stream_rad : max_stream_thick;
 
   // Variability on the stream
-  float *stream_density = new float[n_y*n_phi];
+  stream_density = new float[n_y*n_phi];
 
   // Initialise density distribution
-  for (i = 0 ; i < n_y ; i++)
+  for (i = 0 ; i < n_y ; i++) {
+    Random_stream row_random = random.substream(i);
     for (int j = 0 ; j < n_phi ; j++)
-      stream_density[i*n_phi + j] = pow(((float) rand()) / RAND_MAX, 4.0f);
+      stream_density[i*n_phi + j] = pow(row_random.uniform(), 4.0f);
+  }
+
+  // Save the phase independent properties needed to calculate colours
+  red = red1;
+  green = green1;
+  blue = blue1;
+  opacity = opacity1;
+
+  parallel_grid = new Vec3[n_y];
+  rad_grid = new Vec3[n_vert];
 
   for (i = 0 ; i < n_y ; i++) {
     // Calculate vectors parallel and normal to the stream
@@ -142,6 +142,8 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
     basis_perp = basis_parallel % basis_vert;
     basis_perp.normalize();
 
+    parallel_grid[i] = basis_parallel;
+
     for (int j = 0 ; j < n_phi ; j++) {
       // Calculate azimuthal angle
       float phi = (2.0f * PI * j) / n_phi;
@@ -152,39 +154,8 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
       // Calculate unit vector to stream surface point
       rad_vect = basis_perp * cos(phi) + basis_vert * sin(phi);
 
-      // Calculate opacity - complicated fudge to look good - no physics
-      if (i < 4) alpha = 0.15f * i; 
-      else alpha = 0.5f;
-
-      for (int k = 0 ; k < n_phase ; k++) {
-	// Add randomness to opacity
-	int density_index = static_cast<int>(i - phase[k] / stream_period * n_y);
-	while (density_index < 0) density_index += n_y;
-	while (density_index >= n_y) density_index -= n_y;
-
-	float alpha1 = alpha * stream_density[density_index * n_phi + j];
-	
-	// Determine phase dependent index for storing colour
-	int index1 = k * n_vert + index;
-	
-	// Calculate observer's angle to surface to fudge opacity
-	float mu = fabs(rad_vect * eye_vec[k]);
-	float nu = fabs(basis_parallel * eye_vec[k]);
-	nu = 1.0f / sqrt(1.0f - nu*nu);
-
-	// Assign colours
-#ifdef WIREFRAME
-	red_grid[index1] = 0.0f;
-	green_grid[index1] = 1.0f;
-	blue_grid[index1] = 0.0f;
-	alpha_grid[index1] = 1.0f;
-#else
-	red_grid[index1] = red;
-	green_grid[index1] = green;
-	blue_grid[index1] = blue;
-	alpha_grid[index1] = alpha1 * mu * mu * nu * opacity;
-#endif
-      }
+      // Save for calculating opacities
+      rad_grid[index] = rad_vect;
 
       // Calculate position of stream surface point
       pos_vect = stream[i] + rad_vect * stream_rad;
@@ -210,8 +181,62 @@ Stream_3d::Stream_3d(const int n_phi1, vector<float> phase, const float q,
       *(coord_grid[index]+2) = pos_vect.z;
     }
   }
+}
 
-  // Clean up
+/*
+  Release dynamically allocated memory
+*/
+Stream_3d::~Stream_3d()
+{
+  delete[] parallel_grid;
+  delete[] rad_grid;
   delete[] stream_density;
 }
 
+/*
+  Calculate colours and opacities of the stream at one phase
+*/
+void Stream_3d::calc_colours(const int phase_index, const int offset)
+{
+  const int k = phase_index;
+
+  for (int i = 0 ; i < n_y ; i++) {
+    // Calculate opacity - complicated fudge to look good - no physics
+    float alpha;
+    if (i < 4) alpha = 0.15f * i; 
+    else alpha = 0.5f;
+
+    // Add randomness to opacity
+    int density_index = static_cast<int>(i - phase[k] / stream_period * n_y);
+    while (density_index < 0) density_index += n_y;
+    while (density_index >= n_y) density_index -= n_y;
+
+    for (int j = 0 ; j < n_phi ; j++) {
+      // Determine index offset for this point
+      int index = i * n_phi + j;
+
+      float alpha1 = alpha * stream_density[density_index * n_phi + j];
+
+      // Determine phase dependent index for storing colour
+      int index1 = offset + index;
+
+      // Calculate observer's angle to surface to fudge opacity
+      float mu = fabs(rad_grid[index] * eye_vec[k]);
+      float nu = fabs(parallel_grid[i] * eye_vec[k]);
+      nu = 1.0f / sqrt(1.0f - nu*nu);
+
+      // Assign colours
+#ifdef WIREFRAME
+      red_grid[index1] = 0.0f;
+      green_grid[index1] = 1.0f;
+      blue_grid[index1] = 0.0f;
+      alpha_grid[index1] = 1.0f;
+#else
+      red_grid[index1] = red;
+      green_grid[index1] = green;
+      blue_grid[index1] = blue;
+      alpha_grid[index1] = alpha1 * mu * mu * nu * opacity;
+#endif
+    }
+  }
+}
@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "mathvec.h"
+#include "random_stream.h"
 #include "stream.h"
 #include "transparent_object3d.h"
 
@@ -42,6 +43,21 @@ class Stream_3d : public Transparent_object_3d {
 
   // Define the surface grid
   int n_phi;
+
+  // Unit vectors along the stream at each step and out to each point
+  // on the surface
+  Vec3 *parallel_grid, *rad_grid;
+
+  // Density variations along the stream and the time taken to flow
+  // along it
+  float *stream_density;
+  float stream_period;
+
+  // Colour and opacity of the stream
+  float red, green, blue, opacity;
+
+  // Calculate colours at one phase
+  void calc_colours(const int phase_index, const int offset);
 public: 
   // Constructor
   Stream_3d(const int n_phi1, vector<float> phase, const float q, 
@@ -49,8 +65,11 @@ public:
 	    const float period, const float disc_rad, 
 	    const float t_pole, const float max_stream_thick,
 	    const float open_angle,
-	    const float red, const float green,
-	    const float blue, const float opacity);
+	    const float red1, const float green1,
+	    const float blue1, const float opacity1,
+	    Stream_cache &streams, const Random_stream &random);
+
+  ~Stream_3d();
 };
 
 /*****************************************************************************/
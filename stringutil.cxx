@@ -145,3 +145,29 @@ vector<string> String_util::split_string(const string s, const char delimit,
   return components;
 }
 
+/*
+  Replace every {field} in a string with a value, matching the field
+  name in any case.  Returns false if the field does not appear.
+*/
+bool String_util::replace_field(string &s, const string field, 
+				const string value)
+{
+  string tag = "{" + field + "}";
+  string_toupper(tag);
+
+  bool found = false;
+  string::size_type start = 0;
+  while (true) {
+    string upper = s;
+    string_toupper(upper);
+    string::size_type pos = upper.find(tag, start);
+    if (pos == string::npos) break;
+
+    s.replace(pos, tag.length(), value);
+    start = pos + value.length();
+    found = true;
+  }
+
+  return found;
+}
+
@@ -56,6 +56,9 @@ namespace String_util {
   // Split a string into a vector of delimited substrings
   vector<string> split_string(const string s, const char delimit, 
 			      const bool trim = false);
+
+  // Fill in a {field} of a filename template
+  bool replace_field(string &s, const string field, const string value);
 }
 
 /*****************************************************************************/
@@ -0,0 +1,264 @@
+/*
+  Class to antialias images by rendering into a supersampled
+  framebuffer object and filtering down to the output size
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+// Framebuffer objects are part of OpenGL 3.0
+#ifndef NOGLEXT
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <cmath>
+
+#include <iostream>
+#include <vector>
+
+#include "constants.h"
+#include "supersampler.h"
+
+using std::cout;
+using std::vector;
+
+/*****************************************************************************/
+
+/*
+  Create the framebuffer and filter
+*/
+Supersampler::Supersampler(const int width1, const int height1, 
+			   const int factor1, const int filter, 
+			   Thread_pool &pool1)
+{
+  width = width1;
+  height = height1;
+  factor = factor1;
+  pool = &pool1;
+
+  ready = false;
+  framebuffer = 0;
+  colour_buffer = 0;
+  depth_buffer = 0;
+  samples = 0;
+  image = 0;
+  tap_offset = 0;
+  tap_weight = 0;
+
+#ifndef NOGLEXT
+  // Check the supersampled image is not too large
+  GLint max_size;
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+  if (width * factor > max_size || height * factor > max_size) {
+    cout << "   Supersampled image larger than the maximum of " 
+	 << max_size << " pixels\n";
+    return;
+  }
+
+  // Create framebuffer with colour and depth storage
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &output_framebuffer);
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+  glGenRenderbuffers(1, &colour_buffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colour_buffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width * factor, 
+			height * factor);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 
+			    GL_RENDERBUFFER, colour_buffer);
+
+  glGenRenderbuffers(1, &depth_buffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 
+			width * factor, height * factor);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, 
+			    GL_RENDERBUFFER, depth_buffer);
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, output_framebuffer);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    cout << "   Failed to create supersampled framebuffer\n";
+    return;
+  }
+
+  samples = new GLubyte[width * factor * height * factor * 3];
+  image = new GLubyte[width * height * 3];
+
+  init_filter(filter);
+
+  ready = true;
+#else
+  cout << "   Compiled without framebuffer object support\n";
+#endif
+}
+
+/*
+  Release the framebuffer and images
+*/
+Supersampler::~Supersampler()
+{
+#ifndef NOGLEXT
+  if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+  if (colour_buffer) glDeleteRenderbuffers(1, &colour_buffer);
+  if (depth_buffer) glDeleteRenderbuffers(1, &depth_buffer);
+#endif
+
+  delete[] samples;
+  delete[] image;
+  delete[] tap_offset;
+  delete[] tap_weight;
+}
+
+/*
+  Calculate the filter taps.  Distances are in output pixels from the
+  centre of the output pixel.  The box filter averages the samples
+  within the pixel, the tent filter extends to the centres of the
+  neighbouring pixels and the Lanczos filter (a = 3) to three pixels.
+*/
+void Supersampler::init_filter(const int filter)
+{
+  using Sci_const::PI;
+
+  float radius;
+  if (filter == TENT) radius = 1.0f;
+  else if (filter == LANCZOS) radius = 3.0f;
+  else radius = 0.5f;
+
+  vector<int> offset;
+  vector<float> weight;
+  float total = 0.0f;
+
+  int k_min = static_cast<int> (ceil((0.5f - radius) * factor - 0.5f));
+  int k_max = static_cast<int> (floor((0.5f + radius) * factor - 0.5f));
+  for (int k = k_min ; k <= k_max ; k++) {
+    float d = fabs((k + 0.5f) / factor - 0.5f);
+    if (d >= radius) continue;
+
+    float w;
+    if (filter == TENT) w = 1.0f - d;
+    else if (filter == LANCZOS) {
+      if (d == 0.0f) w = 1.0f;
+      else w = radius * sin(PI * d) * sin(PI * d / radius) / (PI*PI * d*d);
+    } else w = 1.0f;
+
+    offset.push_back(k);
+    weight.push_back(w);
+    total += w;
+  }
+
+  n_taps = offset.size();
+  tap_offset = new int[n_taps];
+  tap_weight = new float[n_taps];
+  for (int i = 0 ; i < n_taps ; i++) {
+    tap_offset[i] = offset[i];
+    tap_weight[i] = weight[i] / total;
+  }
+}
+
+/*
+  Bind the supersampled framebuffer and cover it with the viewport
+*/
+void Supersampler::begin()
+{
+#ifndef NOGLEXT
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &output_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(0, 0, width * factor, height * factor);
+#endif
+}
+
+/*
+  Read back the supersampled image, filter it, and draw the result
+  into the output framebuffer, where the image writers find it
+*/
+void Supersampler::end()
+{
+#ifndef NOGLEXT
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width * factor, height * factor, GL_RGB, 
+	       GL_UNSIGNED_BYTE, samples);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, output_framebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  pool->parallel_for(0, height, [&](int row) { filter_row(row); });
+
+  // Draw the filtered image over the whole window
+  glDisable(GL_DEPTH_TEST);
+  glLoadIdentity();
+  glRasterPos2f(-1.0f, -1.0f);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glDrawPixels(width, height, GL_RGB, GL_UNSIGNED_BYTE, image);
+  glEnable(GL_DEPTH_TEST);
+#endif
+}
+
+/*
+  Filter one row of the output image, first down the columns of
+  samples, then along the row.  Samples beyond the edges are replaced
+  by the nearest edge sample.
+*/
+void Supersampler::filter_row(const int row)
+{
+  const int s_width = width * factor;
+  const int s_height = height * factor;
+
+  // Filter down the columns
+  vector<float> column_sum(s_width * 3, 0.0f);
+  for (int t = 0 ; t < n_taps ; t++) {
+    int s_row = row * factor + tap_offset[t];
+    if (s_row < 0) s_row = 0;
+    else if (s_row >= s_height) s_row = s_height - 1;
+
+    const GLubyte *in = samples + s_row * s_width * 3;
+    const float w = tap_weight[t];
+    for (int i = 0 ; i < s_width * 3 ; i++) column_sum[i] += w * in[i];
+  }
+
+  // Filter along the row
+  GLubyte *out = image + row * width * 3;
+  for (int x = 0 ; x < width ; x++) {
+    float r = 0.0f, g = 0.0f, b = 0.0f;
+    for (int t = 0 ; t < n_taps ; t++) {
+      int s_col = x * factor + tap_offset[t];
+      if (s_col < 0) s_col = 0;
+      else if (s_col >= s_width) s_col = s_width - 1;
+
+      const float w = tap_weight[t];
+      r += w * column_sum[s_col * 3];
+      g += w * column_sum[s_col * 3 + 1];
+      b += w * column_sum[s_col * 3 + 2];
+    }
+
+    // Lanczos filter can overshoot
+    r = (r < 0.0f) ? 0.0f : ((r > 255.0f) ? 255.0f : r);
+    g = (g < 0.0f) ? 0.0f : ((g > 255.0f) ? 255.0f : g);
+    b = (b < 0.0f) ? 0.0f : ((b > 255.0f) ? 255.0f : b);
+
+    out[x * 3] = static_cast<GLubyte> (r + 0.5f);
+    out[x * 3 + 1] = static_cast<GLubyte> (g + 0.5f);
+    out[x * 3 + 2] = static_cast<GLubyte> (b + 0.5f);
+  }
+}
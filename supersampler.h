@@ -0,0 +1,104 @@
+/*
+  Class to antialias images by rendering into a supersampled
+  framebuffer object and filtering down to the output size
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _SUPERSAMPLER_H
+#define _SUPERSAMPLER_H
+
+#ifdef __APPLE__
+	#include <GLUT/glut.h>
+#else
+	#include <GL/glut.h>
+#endif
+
+#include "thread_pool.h"
+
+#include "binsim_stdinc.h"
+
+/*****************************************************************************/
+
+/*
+  The scene is drawn once at factor times the output resolution in
+  each direction, then read back and resampled with a separable
+  filter.  Not available if compiled with -DNOGLEXT.
+*/
+class Supersampler {
+  // Output dimensions and supersampling factor
+  int width, height, factor;
+
+  // Framebuffer object and its colour and depth storage
+  GLuint framebuffer, colour_buffer, depth_buffer;
+
+  // Flag for successful creation
+  bool ready;
+
+  // Filter taps, as offsets in samples from the first sample of an
+  // output pixel, and their weights
+  int n_taps;
+  int *tap_offset;
+  float *tap_weight;
+
+  // Supersampled and filtered images, as RGB bytes
+  GLubyte *samples, *image;
+
+  // Viewport and framebuffer of the output image, restored after
+  // drawing
+  GLint viewport[4];
+  GLint output_framebuffer;
+
+  // Threads used for filtering
+  Thread_pool *pool;
+
+  // Calculate the filter taps
+  void init_filter(const int filter);
+
+  // Filter one row of the output image
+  void filter_row(const int row);
+
+  // Not copyable
+  Supersampler(const Supersampler&);
+  Supersampler& operator= (const Supersampler&);
+public:
+  // Constructor and destructor.  Requires a current OpenGL context
+  Supersampler(const int width1, const int height1, const int factor1,
+	       const int filter, Thread_pool &pool1);
+  ~Supersampler();
+
+  // Was the framebuffer created?
+  bool is_ready() { return ready; }
+
+  // Direct drawing to the supersampled framebuffer
+  void begin();
+
+  // Filter what has been drawn into the output framebuffer
+  void end();
+
+  // Available filters
+  enum { BOX, TENT, LANCZOS };
+};
+
+/*****************************************************************************/
+
+#endif
@@ -0,0 +1,190 @@
+/*
+  Class to run tasks concurrently on a pool of threads
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+#include "thread_pool.h"
+
+/*****************************************************************************/
+
+/*
+  Start the worker threads
+*/
+Thread_pool::Thread_pool(const int n_threads)
+{
+  n_pending = 0;
+  stopping = false;
+
+  int n = n_threads;
+  if (n <= 0) n = std::thread::hardware_concurrency();
+  if (n <= 0) n = 1;
+
+  for (int i = 0 ; i < n ; i++)
+    workers.push_back(std::thread(&Thread_pool::worker, this));
+}
+
+/*
+  Finish outstanding tasks and stop the worker threads
+*/
+Thread_pool::~Thread_pool()
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    stopping = true;
+  }
+  task_ready.notify_all();
+
+  for (unsigned long i = 0 ; i < workers.size() ; i++) workers[i].join();
+}
+
+/*
+  Queue a task to be run
+*/
+void Thread_pool::add_task(const std::function<void()> &task)
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    tasks.push(task);
+    n_pending++;
+  }
+  task_ready.notify_one();
+}
+
+/*
+  Wait for all queued tasks to finish, rethrowing the first exception
+  thrown by any of them
+*/
+void Thread_pool::wait()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while (n_pending > 0) tasks_done.wait(guard);
+
+  if (error) {
+    std::exception_ptr e = error;
+    error = std::exception_ptr();
+    std::rethrow_exception(e);
+  }
+}
+
+/*
+  State of a loop being run by Thread_pool::parallel_for.  This is
+  shared with the helper tasks, which may only start once the loop has
+  finished.
+*/
+struct Parallel_loop {
+  // Loop body
+  std::function<void(int)> body;
+
+  // Next index to run, end of range and number of indices not yet done
+  int next, end, n_left;
+
+  // First exception thrown by the body
+  std::exception_ptr error;
+
+  // Synchronisation of the above
+  std::mutex lock;
+  std::condition_variable done;
+
+  // Run indices until none are left
+  void run();
+};
+
+void Parallel_loop::run()
+{
+  std::unique_lock<std::mutex> guard(lock);
+
+  while (next < end) {
+    int i = next++;
+
+    guard.unlock();
+    try { body(i); }
+    catch (...) {
+      guard.lock();
+      if (!error) error = std::current_exception();
+      guard.unlock();
+    }
+    guard.lock();
+
+    if (--n_left == 0) done.notify_all();
+  }
+}
+
+/*
+  Call body(i) for each i in [begin, end) and return when all have
+  finished, rethrowing the first exception thrown by any of them.  The
+  calling thread takes part in the loop, so it is safe to call this
+  from within a task running on the same pool.
+*/
+void Thread_pool::parallel_for(const int begin, const int end,
+			       const std::function<void(int)> &body)
+{
+  if (end <= begin) return;
+
+  std::shared_ptr<Parallel_loop> loop = std::make_shared<Parallel_loop>();
+  loop->body = body;
+  loop->next = begin;
+  loop->end = end;
+  loop->n_left = end - begin;
+
+  // Offer the rest of the loop to idle workers
+  int n_helpers = end - begin - 1;
+  if (n_helpers > size()) n_helpers = size();
+  for (int i = 0 ; i < n_helpers ; i++)
+    add_task([loop]() { loop->run(); });
+
+  loop->run();
+
+  // Wait for indices taken by workers to finish
+  std::unique_lock<std::mutex> guard(loop->lock);
+  while (loop->n_left > 0) loop->done.wait(guard);
+
+  if (loop->error) std::rethrow_exception(loop->error);
+}
+
+/*
+  Run tasks from the queue until told to stop
+*/
+void Thread_pool::worker()
+{
+  std::unique_lock<std::mutex> guard(lock);
+
+  while (true) {
+    while (!stopping && tasks.empty()) task_ready.wait(guard);
+    if (tasks.empty()) return;
+
+    std::function<void()> task = tasks.front();
+    tasks.pop();
+
+    // Run the task without holding the lock
+    guard.unlock();
+    try { task(); }
+    catch (...) {
+      guard.lock();
+      if (!error) error = std::current_exception();
+      guard.unlock();
+    }
+    guard.lock();
+
+    if (--n_pending == 0) tasks_done.notify_all();
+  }
+}
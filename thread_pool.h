@@ -0,0 +1,95 @@
+/*
+  Class to run tasks concurrently on a pool of threads
+
+  Author: Robert I. Hynes (rhynes@lsu.edu)
+          Louisiana State University
+          Department of Physics and Astronomy
+          Baton Rouge
+          Louisiana, USA
+
+  Copyright (C) 2025 Robert I. Hynes
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "binsim_stdinc.h"
+
+using std::vector;
+
+/*****************************************************************************/
+
+/*
+  Fixed set of worker threads taking tasks from a queue
+*/
+class Thread_pool {
+  // Worker threads
+  vector<std::thread> workers;
+
+  // Tasks waiting to be run
+  std::queue< std::function<void()> > tasks;
+
+  // Number of tasks queued or running
+  int n_pending;
+
+  // First exception thrown by a task, rethrown by wait()
+  std::exception_ptr error;
+
+  // Flag to tell workers to exit
+  bool stopping;
+
+  // Synchronisation of the above
+  std::mutex lock;
+  std::condition_variable task_ready, tasks_done;
+
+  // Main loop of each worker
+  void worker();
+
+  // Not copyable
+  Thread_pool(const Thread_pool&);
+  Thread_pool& operator= (const Thread_pool&);
+public:
+  // Constructor.  By default one thread is created per processor
+  Thread_pool(const int n_threads = 0);
+  ~Thread_pool();
+
+  // Number of worker threads
+  int size() { return workers.size(); }
+
+  // Queue a task to be run
+  void add_task(const std::function<void()> &task);
+
+  // Wait for all queued tasks to finish
+  void wait();
+
+  // Call body(i) for each i in [begin, end), sharing the work between
+  // the calling thread and any idle workers
+  void parallel_for(const int begin, const int end, 
+		    const std::function<void(int)> &body);
+};
+
+/*****************************************************************************/
+
+#endif
@@ -42,12 +42,14 @@ Transparent_disc_3d::Transparent_disc_3d(const int n_steps1,
 		     const float inclination, const float period, 
 		     const float mass, const float disc_thick, 
 		     const float r_disc, const float r_in,
-		     const float beta, const float red, 
-		     const float green, const float blue, 
-		     const float opacity, const int n_flare, 
+		     const float beta, const float red1, 
+		     const float green1, const float blue1, 
+		     const float opacity1, const int n_flare, 
 		     const int flare_length, 
-		     const float hot_red, const float hot_green,
-		     const float hot_blue, const float hot_opacity)
+		     const float hot_red1, const float hot_green1,
+		     const float hot_blue1, const float hot_opacity1,
+		     Stream_cache &streams, Thread_pool &pool1,
+		     const Random_stream &random)
   : Transparent_object_3d(phase, n_steps1*4, n_steps1*2, inclination)
 {
   using namespace Sci_const;
@@ -66,39 +68,28 @@ Transparent_disc_3d::Transparent_disc_3d(const int n_steps1,
   // Create disc model - dummy temperature distribution
   Disc disc(1.0/q, period, mass, disc_thick, r_disc, 1000.0f, 0.0f, beta);
   
-  // Create stream model
-  Stream stream_model(q, mass, period);
+  // Get stream model
+  Stream &stream_model = streams.get_stream(q, mass, period);
   vector<Vec3> stream = stream_model.stream_calc(0.005, r_disc);
 
   // Determine location of hotspot
   Vec3 hotspot_centre = stream[stream.size()-1];
   hotspot_centre.x = lobe.get_c_of_m() - hotspot_centre.x;
 
-  // Coordinates on disc surface
-  float r, phi;
-
-  // Properties of point on the surface
-  Surface_properties surf;
-  
-  // Local opacity
-  float alpha;
-
-  // Index variables
-  int i, index;
-
   // Positions of flares on the disc
-  float *flares = new float[n_rad*n_phi];
+  flares = new float[n_rad*n_phi];
 
   // Initialise flare distribution
-  for (i = 0 ; i < n_rad ; i++)
+  for (int i = 0 ; i < n_rad ; i++)
     for (int j = 0 ; j < n_phi ; j++)
       flares[i*n_phi + j] = 1.0f;
 
   // Add flares
-  for (i = 0 ; i < n_flare ; i++) {
+  for (int i = 0 ; i < n_flare ; i++) {
     // Determine random location of flare
-    int index_r = (int) (((float) rand()) / RAND_MAX * (n_rad-1));
-    int index_phi = (int) (((float) rand()) / RAND_MAX * (n_phi-1));
+    Random_stream flare_random = random.substream(i);
+    int index_r = (int) (flare_random.uniform() * (n_rad-1));
+    int index_phi = (int) (flare_random.uniform() * (n_phi-1));
 
     // Smear flare in azimuth
     if (abs(index_r-n_rad/2) > 3) {
@@ -112,64 +103,135 @@ Transparent_disc_3d::Transparent_disc_3d(const int n_steps1,
   }
 
   // Parameters for extension of hotspot on disc
-  float rDiff, phiDiff, phi0 = PI + atan(-hotspot_centre.y / hotspot_centre.x);
-  float fPhi, fR;
-
-  for (i = 0 ; i < n_rad ; i++) {
-    // Calculate radius
-    if (i < n_rad/2)
-      r =  ((r_disc - r_in) * i / (n_rad/2-1.0f) + r_in) * 
-	lobe.get_eggleton();
-    else
-      r = ((r_disc - r_in) * (n_rad-1-i) / (n_rad/2-1.0f) + r_in) * 
-	lobe.get_eggleton();
-
-    // Calculate Keplerian period as fraction of Porb
-    float p_kep = sqrt(r*r*r*(1.0f + q));
-
-    for (int j = 0 ; j < n_phi ; j++) {
-      // Calculate azimuthal angle
-      phi = (2.0f * PI * j) / n_phi;
-
-      // Determine index offset for this point
-      index = i * n_phi + j;
-
-      // Get properties of the point on the surface
-      surf = disc.get_surface_properties(r, phi);
-      if (i >= n_rad/2) surf.normal.z = -surf.normal.z;
-
-      // Code to add hot spot 
-      phiDiff = phi - phi0;
-      rDiff = fabs(r - r_disc * lobe.get_eggleton());
-      if (phiDiff > 0.0f)
-	fPhi = exp(-1.0f * phiDiff * phiDiff);
-      else 
-	fPhi = exp(-50.0f * phiDiff * phiDiff);
-      fR = exp(-500.0f * rDiff * rDiff);
-
-      for (int k = 0 ; k < n_phase ; k++) {
+  float phi0 = PI + atan(-hotspot_centre.y / hotspot_centre.x);
+
+  hot_phi = new float[n_phi];
+  for (int j = 0 ; j < n_phi ; j++) {
+    float phi = (2.0f * PI * j) / n_phi;
+    float phiDiff = phi - phi0;
+    if (phiDiff > 0.0f)
+      hot_phi[j] = exp(-1.0f * phiDiff * phiDiff);
+    else 
+      hot_phi[j] = exp(-50.0f * phiDiff * phiDiff);
+  }
+
+  // Save the phase independent properties needed to calculate colours
+  red = red1;
+  green = green1;
+  blue = blue1;
+  opacity = opacity1;
+  hot_red = hot_red1;
+  hot_green = hot_green1;
+  hot_blue = hot_blue1;
+  hot_opacity = hot_opacity1;
+  pool = &pool1;
+
+  p_kep = new float[n_rad];
+  hot_r = new float[n_rad];
+  fade = new float[n_rad];
+
+  // Lobe properties used by every ring.  They are read here because
+  // the lobe caches them on first use, which is not safe from several
+  // threads at once.
+  const float r_egg = lobe.get_eggleton();
+  const float c_of_m = lobe.get_c_of_m();
+
+  // Each ring of the disc is independent, so they are shared between
+  // threads
+  pool1.parallel_for(0, n_rad, [&](int i) {
+      // Calculate radius
+      float r;
+      if (i < n_rad/2)
+	r =  ((r_disc - r_in) * i / (n_rad/2-1.0f) + r_in) * 
+	  r_egg;
+      else
+	r = ((r_disc - r_in) * (n_rad-1-i) / (n_rad/2-1.0f) + r_in) * 
+	  r_egg;
+
+      // Calculate Keplerian period as fraction of Porb
+      p_kep[i] = sqrt(r*r*r*(1.0f + q));
+
+      // Radial extent of heating downstream of hot spot
+      float rDiff = fabs(r - r_disc * r_egg);
+      hot_r[i] = exp(-500.0f * rDiff * rDiff);
+
+      // If disc is significantly truncated apply fade-out effect
+      fade[i] = 1.0f;
+      if (r_in > 0.01f) {
+	float frac_r = (r / r_egg - r_in) / 0.2f;
+	if (frac_r < 1.0f) fade[i] = frac_r;
+      }
+
+      for (int j = 0 ; j < n_phi ; j++) {
+	// Calculate azimuthal angle
+	float phi = (2.0f * PI * j) / n_phi;
+
+	// Determine index offset for this point
+	int index = i * n_phi + j;
+
+	// Get properties of the point on the surface
+	Surface_properties surf = disc.get_surface_properties(r, phi);
+
+	if (r_in > 0.0f && (i == 0 || i == n_rad-1))
+	  surf.coords.z = 0.0f;
+	if (i > n_rad/2) surf.coords.z = -surf.coords.z;
+      
+	// Assign coordinates
+	*(coord_grid[index])   = surf.coords.x + c_of_m;
+	*(coord_grid[index]+1) = surf.coords.y;
+	*(coord_grid[index]+2) = surf.coords.z;
+      }
+    });
+}
+
+/*
+  Release dynamically allocated memory
+*/
+Transparent_disc_3d::~Transparent_disc_3d()
+{
+  delete[] p_kep;
+  delete[] hot_r;
+  delete[] fade;
+  delete[] hot_phi;
+  delete[] flares;
+}
+
+/*
+  Calculate colours and opacities of the disc at one phase.  Each ring
+  of the disc is independent, so they are shared between threads.
+*/
+void Transparent_disc_3d::calc_colours(const int phase_index, 
+				       const int offset)
+{
+  const int k = phase_index;
+
+  pool->parallel_for(0, n_rad, [&](int i) {
+      for (int j = 0 ; j < n_phi ; j++) {
+	// Determine index offset for this point
+	int index = i * n_phi + j;
+
+	// Heating downstream of hot spot
+	float fR = hot_r[i], fPhi = hot_phi[j];
+
 	// Determine index for flares allowing for Keplerian rotation
 	int j1;
 	if (i != 0 && i != n_rad-1)
 	  j1 = j - static_cast<int> 
-	    (phase[k] / p_kep * n_phi + 0.5f);
+	    (phase[k] / p_kep[i] * n_phi + 0.5f);
 	else j1 = j;
 	while (j1 < 0) j1 += n_phi;
 
 	// Apply flares to disc
-	alpha = opacity * flares[i*n_phi + j1];
+	float alpha = opacity * flares[i*n_phi + j1];
 
 	// Apply heating downstream of hotspot
 	alpha *= (1.0f + hot_opacity * fR * fPhi);
 
-	// If disc is significantly truncated apply fade-out effect
-	if (r_in > 0.01f) {
-	  float frac_r = (r / lobe.get_eggleton() - r_in) / 0.2f;
-	  if (frac_r < 1.0f) alpha *= frac_r;
-	}
+	// Fade out inner edge of truncated disc
+	alpha *= fade[i];
 
 	// Determine phase dependent index for storing colour
-	int index1 = k * n_vert + index;
+	int index1 = offset + index;
 
 	// Assign colours
 #ifdef WIREFRAME
@@ -178,35 +240,27 @@ Transparent_disc_3d::Transparent_disc_3d(const int n_steps1,
 	blue_grid[index1] = 1.0f;
 	alpha_grid[index1] = 1.0f;
 #else
-	if (i == n_rad/2) {
-	  int index2 = index1 - n_phi;
-	  red_grid[index1] = red_grid[index2];
-	  green_grid[index1] = green_grid[index2];
-	  blue_grid[index1] = blue_grid[index2];
-	  alpha_grid[index1] = alpha_grid[index2];
-	} else {
-	  red_grid[index1] = (red + hot_red * hot_opacity * fR * fPhi) / 
-	    (1.0f + hot_opacity * fR * fPhi);
-	  green_grid[index1] = (green + hot_green * hot_opacity * fR * fPhi) / 
-	    (1.0f + hot_opacity * fR * fPhi);
-	  blue_grid[index1] = (blue + hot_blue * hot_opacity * fR * fPhi) / 
-	    (1.0f + hot_opacity * fR * fPhi);
-	  alpha_grid[index1] = alpha;
-	}
+	red_grid[index1] = (red + hot_red * hot_opacity * fR * fPhi) / 
+	  (1.0f + hot_opacity * fR * fPhi);
+	green_grid[index1] = (green + hot_green * hot_opacity * fR * fPhi) / 
+	  (1.0f + hot_opacity * fR * fPhi);
+	blue_grid[index1] = (blue + hot_blue * hot_opacity * fR * fPhi) / 
+	  (1.0f + hot_opacity * fR * fPhi);
+	alpha_grid[index1] = alpha;
 #endif
       }
-      if (r_in > 0.0f && (i == 0 || i == n_rad-1))
-	surf.coords.z = 0.0f;
-      if (i > n_rad/2) surf.coords.z = -surf.coords.z;
-      
-      // Assign coordinates
-      *(coord_grid[index])   = surf.coords.x + lobe.get_c_of_m();
-      *(coord_grid[index]+1) = surf.coords.y;
-      *(coord_grid[index]+2) = surf.coords.z;
-    }
+    });
+
+#ifndef WIREFRAME
+  // The outer edge of the lower surface takes its colours from the
+  // outer edge of the upper surface
+  for (int j = 0 ; j < n_phi ; j++) {
+    int index1 = offset + (n_rad/2) * n_phi + j;
+    int index2 = index1 - n_phi;
+    red_grid[index1] = red_grid[index2];
+    green_grid[index1] = green_grid[index2];
+    blue_grid[index1] = blue_grid[index2];
+    alpha_grid[index1] = alpha_grid[index2];
   }
-
-  // Clean up
-  delete[] flares;
+#endif
 }
-
@@ -29,6 +29,9 @@
 
 #include <vector>
 
+#include "random_stream.h"
+#include "stream.h"
+#include "thread_pool.h"
 #include "transparent_object3d.h"
 
 #include "binsim_stdinc.h"
@@ -39,6 +42,22 @@ class Transparent_disc_3d : public Transparent_object_3d {
   // Define the surface grid
   int n_steps, n_rad, n_phi;
 
+  // Keplerian period, hot spot profile and fade-out factor of each
+  // ring, and hot spot profile in azimuth
+  float *p_kep, *hot_r, *fade, *hot_phi;
+
+  // Colours and opacities of the disc and the heated area
+  float red, green, blue, opacity;
+  float hot_red, hot_green, hot_blue, hot_opacity;
+
+  // Flare distribution on the disc
+  float *flares;
+
+  // Threads used to calculate colours
+  Thread_pool *pool;
+
+  // Calculate colours at one phase
+  void calc_colours(const int phase_index, const int offset);
 public:
   // Constructor
   Transparent_disc_3d(const int n_steps1, const vector<float> phase, 
@@ -46,11 +65,16 @@ public:
 		      const float inclination, const float period, 
 		      const float mass, const float disc_thick, 
 		      const float r_disc, const float r_in,
-		      const float beta, const float red, const float green,
-		      const float blue, const float opacity,
+		      const float beta, const float red1, 
+		      const float green1, const float blue1, 
+		      const float opacity1,
 		      const int n_flare, const int flare_length, 
-		      const float hot_red, const float hot_green,
-		      const float hot_blue, const float hot_opacity);
+		      const float hot_red1, const float hot_green1,
+		      const float hot_blue1, const float hot_opacity1,
+		      Stream_cache &streams, Thread_pool &pool1,
+		      const Random_stream &random);
+
+  ~Transparent_disc_3d();
 };
 
 /*****************************************************************************/
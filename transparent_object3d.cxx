@@ -50,8 +50,8 @@ Transparent_object_3d::Transparent_object_3d(const vector<float> phase1,
   // Override the object name
   object_name = "Transparent_object_3d";
 
-  // Allocate grid of transparencies
-  alpha_grid = new GLfloat[n_phase*n_vert];
+  // Grid of transparencies is allocated along with the colours
+  alpha_grid = 0;
 }
 
 /*
@@ -63,6 +63,17 @@ Transparent_object_3d::~Transparent_object_3d()
   delete[] alpha_grid;
 }
 
+/*
+  Allocate colour and transparency grids to hold n points
+*/
+void Transparent_object_3d::alloc_colours(const int n)
+{
+  Object_3d::alloc_colours(n);
+
+  delete[] alpha_grid;
+  alpha_grid = new GLfloat[n];
+}
+
 /*
   Generate OpenGL drawing commands
 */
@@ -72,13 +83,20 @@ void Transparent_object_3d::draw(const int phase_index)
   int index_ij, index, index_i;
 
   // More indices
-  const int base_index = phase_index * n_vert;
+  const int base_index = get_colour_offset(phase_index);
 
   // Enable transparency
   glEnable (GL_BLEND);
   glDepthMask (GL_FALSE);
   glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+  if (drawing_buffers()) {
+    draw_buffers(phase_index, base_index);
+    glDepthMask (GL_TRUE);
+    glDisable (GL_BLEND);
+    return;
+  }
+
   // Define object as column of triangle strips
   for (int i = 0 ; i < n_y-1 ; i++) {
     glBegin(GL_TRIANGLE_STRIP);
@@ -115,6 +133,17 @@ void Transparent_object_3d::draw(const int phase_index)
   glDisable (GL_BLEND);
 }
 
+/*
+  Copy colours and transparencies for a phase into colour_data
+*/
+void Transparent_object_3d::fill_colour_buffer(const int base_index)
+{
+  Object_3d::fill_colour_buffer(base_index);
+
+  for (int i = 0 ; i < n_vert ; i++) 
+    colour_data[4*i+3] = alpha_grid[base_index + i];
+}
+
 /*
   Issue OpenGL commands to draw a point.  x and y are for output in
   vertex logging mode only to identify the point.
@@ -40,8 +40,14 @@ protected:
   // Add transparency grid
   GLfloat *alpha_grid;
 
+  // Allocate colour and transparency grids to hold n points
+  virtual void alloc_colours(const int n);
+
   // Issue OpenGL commands to draw a point
   virtual void draw_point(int coord_index, int color_index, int x, int y);
+
+  // Copy colours and transparencies for a phase into colour_data
+  virtual void fill_colour_buffer(const int base_index);
 public:
   // Constructor and destructor
   Transparent_object_3d(const vector<float> phase1, const int n_x1, 